@@ -0,0 +1,72 @@
+import gzip
+import os
+
+# Writes an "assets.idx" manifest into every data directory that holds the
+# SPAmanager system files, so SPAmanager::begin() can learn what is on the
+# filesystem with a single read instead of probing every file.
+#
+# One line per file: <name> <size> <digest>
+# The digest is the same FNV-1a hash the SPAmanager uses for its pages.
+#
+# Text assets also get a gzipped "<name>.gz" sibling, which the SPAmanager
+# sends instead to clients that accept gzip.
+
+DATA_DIR = "data"
+MANIFEST_NAME = "assets.idx"
+MARKER_FILE = "SPAmanager.html"
+GZIP_EXTENSIONS = (".html", ".css", ".js")
+GZIP_MIN_SIZE = 1024
+
+def fnv1a(data):
+    digest = 2166136261
+    for byte in data:
+        digest ^= byte
+        digest = (digest * 16777619) & 0xFFFFFFFF
+    return digest
+
+def write_gzip_siblings(directory):
+    for name in sorted(os.listdir(directory)):
+        path = os.path.join(directory, name)
+        if not name.endswith(GZIP_EXTENSIONS) or not os.path.isfile(path):
+            continue
+        gz_path = path + ".gz"
+        if os.path.exists(gz_path) and os.path.getmtime(gz_path) >= os.path.getmtime(path):
+            continue
+        with open(path, "rb") as f:
+            content = f.read()
+        # mtime=0 keeps the output (and so the filesystem image) the same for the same input
+        compressed = gzip.compress(content, 9, mtime=0)
+        if len(content) < GZIP_MIN_SIZE or len(compressed) > len(content) * 0.9:
+            if os.path.exists(gz_path):
+                os.remove(gz_path)
+            continue
+        with open(gz_path, "wb") as f:
+            f.write(compressed)
+        print(f"Wrote {gz_path} ({len(content)} -> {len(compressed)} bytes)")
+
+def write_manifest(directory):
+    lines = []
+    for name in sorted(os.listdir(directory)):
+        path = os.path.join(directory, name)
+        if name == MANIFEST_NAME or not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            content = f.read()
+        lines.append(f"{name} {len(content)} {fnv1a(content):08x}\n")
+
+    manifest_path = os.path.join(directory, MANIFEST_NAME)
+    new_manifest = "".join(lines)
+    # Only touch the manifest when something changed
+    if os.path.exists(manifest_path):
+        with open(manifest_path, "r") as f:
+            if f.read() == new_manifest:
+                return
+    with open(manifest_path, "w") as f:
+        f.write(new_manifest)
+    print(f"Wrote {manifest_path} ({len(lines)} files)")
+
+if os.path.isdir(DATA_DIR):
+    for root, dirs, files in os.walk(DATA_DIR):
+        if MARKER_FILE in files:
+            write_gzip_siblings(root)
+            write_manifest(root)
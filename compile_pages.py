@@ -0,0 +1,174 @@
+import gzip
+import os
+import re
+
+# Compiles the html pages in "pages/" into "include/SPApages.h", to be added
+# with SPAmanager::addCompiledPage(). Every page is minified and gets an index
+# of its elements with an id, so the SPAmanager does not have to scan the page
+# to find an element for setPlaceholder() and friends.
+#
+# pages/Main.html  ->  constexpr SPAcompiledPage spaPage_Main
+#
+# The index holds, per id, the offset of the '<' that opens the element, of the
+# '>' that closes its opening tag and of the next '<' (the end of its text).
+# It is computed the same way SPAmanager::locateElement() scans a page.
+#
+# With GZIP_PAGES every page also gets a gzipped copy, which the SPAmanager
+# streams to browsers that can decompress it, as long as the page is unmodified.
+
+PAGES_DIR = "pages"
+OUTPUT_FILE = os.path.join("include", "SPApages.h")
+MAX_TAG_LEN = 512   # SPAmanager::MAX_TAG_LEN
+GZIP_PAGES = True
+
+# Whitespace in these elements is content, leave them alone
+RAW_ELEMENTS = ("pre", "textarea", "script", "style")
+
+
+# A tag, with '>' allowed inside its quoted attribute values
+TAG = re.compile(r"""(<(?:[^<>"']|"[^"]*"|'[^']*')*>)""")
+
+
+def minify_text(part):
+    part = re.sub(r"<!--(?!\[).*?-->", "", part, flags=re.DOTALL)
+    # A run of whitespace renders as one space, also between two inline elements.
+    # Tags are kept as they are, so attribute values do not change.
+    pieces = TAG.split(part)
+    for i in range(0, len(pieces), 2):
+        pieces[i] = re.sub(r"\s+", " ", pieces[i])
+    return "".join(pieces)
+
+
+def minify(html):
+    raw = re.compile(r"<(%s)\b.*?</\1\s*>" % "|".join(RAW_ELEMENTS), flags=re.IGNORECASE | re.DOTALL)
+    result = []
+    last = 0
+    for match in raw.finditer(html):
+        result.append(minify_text(html[last:match.start()]))
+        result.append(match.group(0))
+        last = match.end()
+    result.append(minify_text(html[last:]))
+    return "".join(result).strip()
+
+
+def tag_id(tag):
+    # Same rule as SPAmanager::getTagAttribute(): whitespace before "id=", quoted value
+    match = re.search(r"\sid=(['\"])(.*?)\1", tag, flags=re.DOTALL)
+    return match.group(2) if match else None
+
+
+def index_elements(html):
+    # Offsets are in bytes, like the runtime sees the page
+    html = html.encode("utf-8")
+    elements = []
+    seen = set()
+    pos = html.find(b"<")
+    while pos != -1:
+        end = html.find(b">", pos)
+        next_open = html.find(b"<", pos + 1)
+        if end == -1:
+            break
+        if next_open != -1 and next_open < end:
+            # A '<' inside a tag starts a new tag, like it does for the runtime scan
+            pos = next_open
+            continue
+        tag = html[pos:end + 1]
+        element_id = tag_id(tag.decode("utf-8", "replace")) if len(tag) <= MAX_TAG_LEN else None
+        if element_id is not None and element_id not in seen:
+            seen.add(element_id)
+            text_end = html.find(b"<", end + 1)
+            elements.append((element_id, pos, end, len(html) if text_end == -1 else text_end))
+        pos = next_open
+    return elements
+
+
+def c_string(text, indent="    "):
+    encoded = text.encode("utf-8")
+    lines = []
+    line = ""
+    for byte in encoded:
+        char = chr(byte)
+        if char == "\\" or char == '"':
+            line += "\\" + char
+        elif char == "?":
+            line += "\\?"   # No trigraphs
+        elif 32 <= byte < 127:
+            line += char
+        else:
+            line += "\\%03o" % byte
+        if len(line) >= 100:
+            lines.append(line)
+            line = ""
+    if line or not lines:
+        lines.append(line)
+    return "\n".join(indent + '"' + l + '"' for l in lines)
+
+
+def c_bytes(data, indent="    "):
+    lines = []
+    for i in range(0, len(data), 20):
+        lines.append(indent + ", ".join("0x%02x" % byte for byte in data[i:i + 20]) + ",")
+    return "\n".join(lines)
+
+
+def identifier(name):
+    return re.sub(r"[^A-Za-z0-9_]", "_", name)
+
+
+def compile_page(name, html):
+    ident = "spaPage_" + identifier(name)
+    minified = minify(html)
+    elements = index_elements(minified)
+
+    out = []
+    out.append(f"//-- {name}: {len(html.encode('utf-8'))} -> {len(minified.encode('utf-8'))} bytes, {len(elements)} elements")
+    out.append(f"constexpr char {ident}_html[] =\n{c_string(minified)};")
+    if elements:
+        out.append(f"constexpr SPAcompiledPage::Element {ident}_elements[] = {{")
+        for element_id, tag_start, tag_end, text_end in elements:
+            out.append(f"    {{ {c_string(element_id, '').strip()}, {tag_start}, {tag_end}, {text_end} }},")
+        out.append("};")
+        element_table = f"{ident}_elements, {len(elements)}"
+    else:
+        element_table = "nullptr, 0"
+    gzip_table = "nullptr, 0"
+    if GZIP_PAGES:
+        compressed = gzip.compress(minified.encode("utf-8"), 9, mtime=0)
+        if len(compressed) < len(minified.encode("utf-8")):
+            out[0] += f", {len(compressed)} bytes gzipped"
+            out.append(f"constexpr uint8_t {ident}_gzip[] = {{\n{c_bytes(compressed)}\n}};")
+            gzip_table = f"{ident}_gzip, sizeof({ident}_gzip)"
+    out.append(f"constexpr SPAcompiledPage {ident} = {{ \"{name}\", {ident}_html, sizeof({ident}_html) - 1, {element_table}, {gzip_table} }};")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    if not os.path.isdir(PAGES_DIR):
+        return
+
+    sections = []
+    for file_name in sorted(os.listdir(PAGES_DIR)):
+        if not file_name.endswith(".html"):
+            continue
+        with open(os.path.join(PAGES_DIR, file_name), "r", encoding="utf-8") as f:
+            sections.append(compile_page(file_name[:-len(".html")], f.read()))
+
+    header = ("// Generated by compile_pages.py from the files in " + PAGES_DIR + "/, do not edit\n"
+              "#ifndef SPA_PAGES_H\n"
+              "#define SPA_PAGES_H\n\n"
+              "#include <SPAmanager.h>\n\n"
+              + "\n".join(sections) +
+              "\n#endif // SPA_PAGES_H\n")
+
+    # Only touch the header when something changed, so nothing gets rebuilt for nothing
+    if os.path.exists(OUTPUT_FILE):
+        with open(OUTPUT_FILE, "r", encoding="utf-8") as f:
+            if f.read() == header:
+                return
+    os.makedirs(os.path.dirname(OUTPUT_FILE), exist_ok=True)
+    with open(OUTPUT_FILE, "w", encoding="utf-8") as f:
+        f.write(header)
+    print(f"Wrote {OUTPUT_FILE} ({len(sections)} pages)")
+
+
+main()
@@ -4,316 +4,527 @@ let pages = {};
 let pageContent = '';
 let receivedChunks = 0;
 let totalChunks = 0;
+// Page chunks travel in a lower priority lane than updates and JS calls.
+// Frames that touch the page are held back until the streamed page is rendered.
+let pageStreamPending = false;
+let deferredFrames = [];
+// Flow control: tell the server how many frames arrived so it knows when we fall behind
+let framesReceived = 0;
+let framesAcked = 0;
+let ackTimer = null;
+// Gzipped pages arrive as binary frames after a 'pageGzip' header
+const acceptsGzip = typeof DecompressionStream !== 'undefined';
+let gzipChunks = [];
+let gzipReceived = 0;
+let gzipSize = 0;
+let gzipStream = 0;
+// Pages are kept by content digest, the server only sends a page we do not have yet
+const PAGE_CACHE_PREFIX = 'spaPage:';
+let pageCache = {};
+let streamPage = null;
+let streamDigest = null;
+// Popup templates are kept the same way, and parsed only once
+const POPUP_CACHE_PREFIX = 'spaPopup:';
+let popupCache = {};
+let popupTemplates = new Map();
+// The page the server rendered into SPAmanager.html, if it did
+let renderedPage = null;
+// Updates wait for the next animation frame, only the last value per target is applied
+let pendingUpdates = new Map();
+let updateFrameRequested = false;
+// Set by the server with setClientOptions(), and kept for the next load so they apply from the start
+const LOG_ERRORS = 0;
+const LOG_INFO = 1;
+const LOG_DEBUG = 2;
+const CLIENT_OPTIONS_KEY = 'spaClientOptions';
+let logLevel = LOG_DEBUG;
+let frameWorker = null;
 
-console.log('====> SPAmanager.js loaded');
+function debugLog(...args) {
+  if (logLevel >= LOG_DEBUG) {
+    console.log(...args);
+  }
+}
+
+function infoLog(...args) {
+  if (logLevel >= LOG_INFO) {
+    console.log(...args);
+  }
+}
+
+infoLog('====> SPAmanager.js loaded');
 
 function connect() {
-    ws = new WebSocket('ws://' + window.location.hostname + ':81');
+    ws = new WebSocket('ws://' + window.location.hostname + ':81/' + (acceptsGzip ? '?gzip=1' : ''));
+    ws.binaryType = 'arraybuffer';
 
     ws.onopen = () => {
-        // Send pageLoaded signal
+        framesReceived = 0;
+        framesAcked = 0;
+        // Send pageLoaded signal, with the pages we already have
         ws.send(JSON.stringify({
-            type: 'pageLoaded'
+            type: 'pageLoaded',
+            pageDigests: cachedPageDigests(),
+            popupDigests: cachedDigests(popupCache, POPUP_CACHE_PREFIX)
         }));
     };
 
     ws.addEventListener('message', (event) => {
+      framesReceived++;
+      scheduleAck();
+      if (frameWorker) {
+          // Parsed (and updates merged) off the main thread, handed back in order
+          frameWorker.postMessage(event.data);
+          return;
+      }
+      if (event.data instanceof ArrayBuffer) {
+          receiveGzipChunk(event.data);
+          return;
+      }
       try {
-            const data = JSON.parse(event.data);
-            console.log("Message received:", data);
-            
-            // Handle page chunks
-            if (data.type === 'pageChunk') {
-                console.log(`Received page chunk ${data.chunkIndex + 1}/${data.totalChunks}`);
-                
-                // If this is the first chunk, reset the content
-                if (data.chunkIndex === 0) {
-                    pageContent = '';
-                    receivedChunks = 0;
-                    totalChunks = data.totalChunks;
-                }
-                
-                // Accumulate chunks
-                pageContent += data.content;
-                receivedChunks++;
-                
-                // Update loading progress
-                updateLoadingProgress(receivedChunks, totalChunks);
-                
-                // If this is the final chunk or we've received all chunks, update the page
-                if (data.final || receivedChunks >= totalChunks) {
-                    console.log('All chunks received, updating page content');
-                    const bodyContent = document.getElementById('bodyContent');
-                    bodyContent.innerHTML = pageContent;
-                    bodyContent.style.display = 'block';
-                    
-                    // Reset for next time
-                    pageContent = '';
-                    receivedChunks = 0;
-                    totalChunks = 0;
-                    
-                    // Add input listeners to all input fields
-                    document.querySelectorAll('input[id]').forEach(input => {
-                        if (!input.hasInputListener) {
-                            input.addEventListener('input', () => {
-                                ws.send(JSON.stringify({
-                                    type: 'inputChange',
-                                    placeholder: input.id,
-                                    value: input.value
-                                }));
-                            });
-                            input.hasInputListener = true;
-                        }
-                    });
-                }
-                return;
-            }
-            
-            // Handle single content message
-            if (data.type === 'pageContent') {
-                console.log('Received complete page content');
-                const bodyContent = document.getElementById('bodyContent');
-                bodyContent.innerHTML = data.content;
-                bodyContent.style.display = 'block';
-                
-                // Add input listeners to all input fields
-                document.querySelectorAll('input[id]').forEach(input => {
-                    if (!input.hasInputListener) {
-                        input.addEventListener('input', () => {
-                            ws.send(JSON.stringify({
-                                type: 'inputChange',
-                                placeholder: input.id,
-                                value: input.value
-                            }));
-                        });
-                        input.hasInputListener = true;
-                    }
-                });
-                return;
-            }
-    
-            if (data.event === 'includeJsFile') {
-              console.log(`addEventListener(): includeJsFile: [${data.data}]`);
-              handleEvent('includeJsFile', data.data);
-              return;
-            }
-            if (data.event === 'callJsFunction') {
-              console.log('addEventListener(): callJsFunction:', data.data);
-              handleEvent('callJsFunction', data);
-              return;
-            }
-            if (data.event === 'includeCssFile') {
-              console.log(`addEventListener(): includeCssFile: [${data.data}]`);
-              handleEvent('includeCssFile', data.data);
-              return;
-            }
-            if (data.event === 'showPopup') {
-              console.log('addEventListener(): showPopup:', data.id);
-              handleEvent('showPopup', data);
-              return;
-            }
-            // Handle Redirect
-            if (data.type === 'redirect') {
-              window.location.href = data.url;
-              return;
-            }
-    
-            // Handle Partial Update
-            if (data.type === 'update') {
-              const target = document.getElementById(data.target);
-              if (target) {
-                if (data.target === 'bodyContent') {
-                    target.innerHTML = data.content;
-                } else if (target.tagName === 'INPUT') {
-                    target.value = data.content;
-                } else {
-                    target.textContent = data.content;
-                }
-              }
-              return;
-            }
-            
-            // Handle custom message types - don't treat them as full state updates
-            if (data.type === 'custom') {
-              console.log("Processing custom message:", data);
-              return;
-            }
-            
-            // Only process as a full state update if it has the expected properties
-            if (data.hasOwnProperty('body') || data.hasOwnProperty('menus')) {
-              console.log("Processing full state update");
-              
-              // Handle Full State Update
-              if (data.body) {
-                const bodyContent = document.getElementById('bodyContent');
-                bodyContent.innerHTML = data.body;
-                bodyContent.style.display = data.isVisible ? 'block' : 'none';
-        
-                // Efficient Input Listener Addition
-                document.querySelectorAll('input[id]').forEach(input => {
-                    if (!input.hasInputListener) {
-                        input.addEventListener('input', () => {
-                            ws.send(JSON.stringify({
-                                type: 'inputChange',
-                                placeholder: input.id,
-                                value: input.value
-                            }));
-                        });
-                        input.hasInputListener = true;
+          handleFrame(JSON.parse(event.data));
+      } catch (error) {
+          console.error('Error parsing message:', error);
+      }
+    });
+
+    ws.onclose = () => setTimeout(connect, 1000);
+} // connect()
+
+function handleFrame(data) {
+    debugLog("Message received:", data);
+
+    // Handle page chunks
+    if (data.type === 'pageChunk') {
+        debugLog(`Received page chunk ${data.chunkIndex + 1}/${data.totalChunks}`);
+
+        // If this is the first chunk, reset the content
+        if (data.chunkIndex === 0) {
+            pageContent = '';
+            receivedChunks = 0;
+            totalChunks = data.totalChunks;
+            streamPage = data.page;
+            streamDigest = data.digest;
+        }
+
+        // Accumulate chunks
+        pageContent += data.content;
+        receivedChunks++;
+
+        // Update loading progress
+        updateLoadingProgress(receivedChunks, totalChunks);
+
+        // If this is the final chunk or we've received all chunks, update the page
+        if (data.final || receivedChunks >= totalChunks) {
+            debugLog('All chunks received, updating page content');
+            const content = pageContent;
+            cachePage(streamPage, streamDigest, content);
+
+            // Reset for next time
+            pageContent = '';
+            receivedChunks = 0;
+            totalChunks = 0;
+            showStreamedPage(content);
+        }
+        return;
+    }
+
+    // A gzipped page follows in binary frames
+    if (data.type === 'pageGzip') {
+        debugLog(`Receiving gzipped page of ${data.size} bytes`);
+        gzipStream++;
+        gzipChunks = [];
+        gzipReceived = 0;
+        gzipSize = data.size;
+        totalChunks = data.totalChunks;
+        streamPage = data.page;
+        streamDigest = data.digest;
+        return;
+    }
+
+    // We told the server we have this version of the page
+    if (data.type === 'pageCached') {
+        if (renderedPage && renderedPage.page === data.page && renderedPage.digest === data.digest) {
+            debugLog(`Keeping rendered page [${data.page}]`);
+            showStreamedPage(null);
+            return;
+        }
+        const content = cachedPage(data.page, data.digest);
+        if (content !== null) {
+            debugLog(`Showing cached page [${data.page}]`);
+            showStreamedPage(content);
+        } else {
+            ws.send(JSON.stringify({ type: 'pageCacheMiss', page: data.page }));
+        }
+        return;
+    }
+
+    // Handle single content message
+    if (data.type === 'pageContent') {
+        debugLog('Received complete page content');
+        const bodyContent = document.getElementById('bodyContent');
+        renderPage(data.content);
+        bodyContent.style.display = 'block';
+        flushDeferredFrames();
+        return;
+    }
+
+    if (data.type === 'clientOptions') {
+      applyClientOptions(data);
+      try {
+        localStorage.setItem(CLIENT_OPTIONS_KEY, JSON.stringify({ logLevel: data.logLevel, worker: data.worker }));
+      } catch (error) {
+        // Storage full or disabled, the options apply until a reload
+      }
+      return;
+    }
+
+    if (data.event === 'includeAssets') {
+      debugLog('addEventListener(): includeAssets:', data.assets);
+      includeAssets(data.assets, data.bundles || {});
+      updateServiceWorker(data.serviceWorker);
+      return;
+    }
+    if (data.event === 'includeJsFile') {
+      debugLog(`addEventListener(): includeJsFile: [${data.data}]`);
+      handleEvent('includeJsFile', data.data);
+      return;
+    }
+    if (data.event === 'callJsFunction') {
+      debugLog('addEventListener(): callJsFunction:', data.data);
+      if (deferFrame(data)) return;
+      handleEvent('callJsFunction', data);
+      return;
+    }
+    if (data.event === 'includeCssFile') {
+      debugLog(`addEventListener(): includeCssFile: [${data.data}]`);
+      handleEvent('includeCssFile', data.data);
+      return;
+    }
+    if (data.event === 'showPopup') {
+      debugLog('addEventListener(): showPopup:', data.id);
+      handleEvent('showPopup', data);
+      return;
+    }
+    // Handle Redirect
+    if (data.type === 'redirect') {
+      window.location.href = data.url;
+      return;
+    }
+
+    // Handle Partial Update
+    if (data.type === 'update') {
+      if (data.target !== 'title' && deferFrame(data)) return;
+      queueUpdate(data.target, data.content);
+      return;
+    }
+
+    // Handle batched updates of bound variables
+    if (data.type === 'updates') {
+      if (deferFrame(data)) return;
+      data.updates.forEach(update => queueUpdate(update.target, update.content));
+      return;
+    }
+
+    // Handle custom message types - don't treat them as full state updates
+    if (data.type === 'custom') {
+      debugLog("Processing custom message:", data);
+      return;
+    }
+
+    // Only process as a full state update if it has the expected properties
+    if (data.hasOwnProperty('body') || data.hasOwnProperty('menus')) {
+      debugLog("Processing full state update");
+      // The page itself follows in the bulk lane
+      pageStreamPending = data.hasContent === true;
+
+      // Handle Full State Update
+      if (data.body) {
+        const bodyContent = document.getElementById('bodyContent');
+        renderPage(data.body);
+        bodyContent.style.display = data.isVisible ? 'block' : 'none';
+      }
+
+      // Dynamic Menu Rendering
+      if (data.menus) {
+        const menuContainer = document.querySelector('.dM_left');
+        menuContainer.innerHTML = '';
+        if (data.menus && data.menus.length > 0) {
+            data.menus.forEach(menu => {
+                const menuDiv = document.createElement('div');
+                menuDiv.className = 'dM_dropdown';
+                const menuSpan = document.createElement('span');
+                menuSpan.textContent = menu.name;
+                menuDiv.appendChild(menuSpan);
+
+                const menuList = document.createElement('ul');
+                menuList.className = 'dM_dropdown-menu';
+                menu.items.forEach(item => {
+                    const li = document.createElement('li');
+                    if (item.disabled) li.className = 'disabled';
+                    const link = document.createElement(item.url ? 'a' : 'span');
+                    link.textContent = item.name;
+                    if (item.url) link.href = item.url;
+                    link.dataset.menu = menu.name;
+                    link.dataset.item = item.name;
+                    link.dataset.id = item.id;
+                    if (!item.disabled && !item.url) {
+                        link.onclick = () => handleMenuClick(menu.name, item.name, item.id);
                     }
+                    li.appendChild(link);
+                    menuList.appendChild(li);
                 });
-              }
-    
-              // Dynamic Menu Rendering
-              if (data.menus) {
-                const menuContainer = document.querySelector('.dM_left');
-                menuContainer.innerHTML = '';
-                if (data.menus && data.menus.length > 0) {
-                    data.menus.forEach(menu => {
-                        const menuDiv = document.createElement('div');
-                        menuDiv.className = 'dM_dropdown';
-                        const menuSpan = document.createElement('span');
-                        menuSpan.textContent = menu.name;
-                        menuDiv.appendChild(menuSpan);
-        
-                        const menuList = document.createElement('ul');
-                        menuList.className = 'dM_dropdown-menu';
-                        menu.items.forEach(item => {
-                            const li = document.createElement('li');
-                            if (item.disabled) li.className = 'disabled';
-                            const link = document.createElement(item.url ? 'a' : 'span');
-                            link.textContent = item.name;
-                            if (item.url) link.href = item.url;
-                            if (!item.disabled && !item.url) {
-                                link.onclick = () => handleMenuClick(menu.name, item.name);
-                            }
-                            li.appendChild(link);
-                            menuList.appendChild(li);
-                        });
-                        menuDiv.appendChild(menuList);
-                        menuContainer.appendChild(menuDiv);
-                    });
-                }
-              }
-            } else {
-              console.log("Received message that is not a full state update:", data);
-            }
-            
-            // Check if this is a popup message
-            if (data.isPopup && data.message) {
-              console.log("Processing popup message:", data.message);
-              console.log("showCloseButton:", data.showCloseButton);
-              console.log("messageDuration:", data.messageDuration);
-              
-              // Create popup content with or without close button
-              let popupContent = `<div class="popup-message">${data.message}</div>`;
-              
-              // Add countdown timer for messages with duration
-              if (data.messageDuration > 0) {
-                  let remainingSeconds = Math.ceil(data.messageDuration / 1000);
-                  popupContent += `<div id="popup-countdown" style="margin-top: 10px; text-align: center; font-size: 12px; color: #666;">Closing in ${remainingSeconds} seconds</div>`;
-              }
-              
-              // Add close button if needed
-              if (data.showCloseButton) {
-                  popupContent += `<button type="button" onClick="closePopup('popup_message')">Close</button>`;
-              }
-              
-              // Show the popup
-              showPopup('popup_message', popupContent);
-              
-              // Setup countdown timer
-              if (data.messageDuration > 0) {
-                  let remainingSeconds = Math.ceil(data.messageDuration / 1000);
-                  console.log(`Setting up countdown timer for ${remainingSeconds} seconds`);
-                  
-                  // Clear any existing interval
-                  if (window.popupCountdownInterval) {
-                      clearInterval(window.popupCountdownInterval);
-                      window.popupCountdownInterval = null;
+                menuDiv.appendChild(menuList);
+                menuContainer.appendChild(menuDiv);
+            });
+        }
+      }
+    } else {
+      debugLog("Received message that is not a full state update:", data);
+    }
+
+    // Check if this is a popup message
+    if (data.isPopup && data.message) {
+      debugLog("Processing popup message:", data.message);
+      debugLog("showCloseButton:", data.showCloseButton);
+      debugLog("messageDuration:", data.messageDuration);
+
+      // Create popup content with or without close button
+      let popupContent = `<div class="popup-message">${data.message}</div>`;
+
+      // Add countdown timer for messages with duration
+      if (data.messageDuration > 0) {
+          let remainingSeconds = Math.ceil(data.messageDuration / 1000);
+          popupContent += `<div id="popup-countdown" style="margin-top: 10px; text-align: center; font-size: 12px; color: #666;">Closing in ${remainingSeconds} seconds</div>`;
+      }
+
+      // Add close button if needed
+      if (data.showCloseButton) {
+          popupContent += `<button type="button" onClick="closePopup('popup_message')">Close</button>`;
+      }
+
+      // Show the popup
+      showPopup('popup_message', popupContent);
+
+      // Setup countdown timer
+      if (data.messageDuration > 0) {
+          let remainingSeconds = Math.ceil(data.messageDuration / 1000);
+          debugLog(`Setting up countdown timer for ${remainingSeconds} seconds`);
+
+          // Clear any existing interval
+          if (window.popupCountdownInterval) {
+              clearInterval(window.popupCountdownInterval);
+              window.popupCountdownInterval = null;
+          }
+
+          const countdownId = setInterval(() => {
+              remainingSeconds--;
+              debugLog(`Countdown: ${remainingSeconds} seconds remaining`);
+
+              const countdownElement = document.getElementById('popup-countdown');
+              if (countdownElement) {
+                  if (remainingSeconds > 0) {
+                      countdownElement.textContent = `Closing in ${remainingSeconds} seconds`;
+                  } else {
+                      countdownElement.textContent = 'Closing now...';
+                      clearInterval(countdownId);
+                      setTimeout(() => {
+                          closePopup('popup_message');
+                      }, 500); // Small delay to show "Closing now..." message
                   }
-                  
-                  const countdownId = setInterval(() => {
-                      remainingSeconds--;
-                      console.log(`Countdown: ${remainingSeconds} seconds remaining`);
-                      
-                      const countdownElement = document.getElementById('popup-countdown');
-                      if (countdownElement) {
-                          if (remainingSeconds > 0) {
-                              countdownElement.textContent = `Closing in ${remainingSeconds} seconds`;
-                          } else {
-                              countdownElement.textContent = 'Closing now...';
-                              clearInterval(countdownId);
-                              setTimeout(() => {
-                                  closePopup('popup_message');
-                              }, 500); // Small delay to show "Closing now..." message
-                          }
-                      } else {
-                          // Element not found, clear the interval
-                          console.log('Countdown element not found, clearing interval');
-                          clearInterval(countdownId);
-                      }
-                  }, 1000);
-                  
-                  // Store the interval ID so it can be cleared if needed
-                  window.popupCountdownInterval = countdownId;
+              } else {
+                  // Element not found, clear the interval
+                  debugLog('Countdown element not found, clearing interval');
+                  clearInterval(countdownId);
               }
-          
-            } else {
-                // Regular Message Handling and Timed Removal
-                const msg = document.getElementById('message');
-                if (window.messageTimer) {
-                    clearTimeout(window.messageTimer);
-                    window.messageTimer = null;
-                }
-                msg.textContent = data.message || '';
-                msg.className = data.message ? (data.isError ? 'error-message' : 'normal-message') : '';
-                if (data.message && data.messageDuration > 0) {
-                    window.messageTimer = setTimeout(() => {
-                        msg.textContent = '';
-                        msg.className = '';
-                        window.messageTimer = null;
-                    }, data.messageDuration);
-                }
-            }
-        } catch (error) {
-            console.error('Error parsing message:', error);
+          }, 1000);
+
+          // Store the interval ID so it can be cleared if needed
+          window.popupCountdownInterval = countdownId;
+      }
+
+    } else {
+        // Regular Message Handling and Timed Removal
+        const msg = document.getElementById('message');
+        if (window.messageTimer) {
+            clearTimeout(window.messageTimer);
+            window.messageTimer = null;
+        }
+        msg.textContent = data.message || '';
+        msg.className = data.message ? (data.isError ? 'error-message' : 'normal-message') : '';
+        if (data.message && data.messageDuration > 0) {
+            window.messageTimer = setTimeout(() => {
+                msg.textContent = '';
+                msg.className = '';
+                window.messageTimer = null;
+            }, data.messageDuration);
         }
+    }
+} // handleFrame()
+
+let scriptLoadPromises = {};  // Track script load status
+
+function assetName(url) {
+  return '/' + url.split('?')[0].split('/').pop();
+}
+
+// A client that has none of the files yet takes each type as one bundle
+function includeBundles(assets, bundles) {
+  const isLoaded = (asset) => asset.type === 'css'
+      ? document.querySelector(`link[href="${asset.url}"]`) !== null
+      : (scriptLoadPromises[assetName(asset.url)] !== undefined || document.querySelector(`script[src="${asset.url}"]`) !== null);
+  const bundled = [];
+
+  if (bundles.css && !assets.some(asset => asset.type === 'css' && isLoaded(asset))) {
+    if (!document.querySelector(`link[href="${bundles.css}"]`)) {
+      handleEvent('includeCssFile', bundles.css);
+    }
+    bundled.push('css');
+  }
+  if (bundles.js && !assets.some(asset => asset.type !== 'css' && isLoaded(asset))) {
+    if (!document.querySelector(`script[src="${bundles.js}"]`)) {
+      const names = assets.filter(asset => asset.type !== 'css').map(asset => assetName(asset.url));
+      const loaded = new Promise((resolve) => {
+        const script = document.createElement('script');
+        script.src = bundles.js;
+        script.onload = script.onerror = () => {
+          debugLog(`Bundle [${bundles.js}] loaded`);
+          names.forEach(name => delete scriptLoadPromises[name]);
+          resolve();
+        };
+        document.body.appendChild(script);
+      });
+      names.forEach(name => scriptLoadPromises[name] = loaded);
+    }
+    bundled.push('js');
+  }
+  return bundled;
+}
+
+// Fetch all assets at once, but run every script only after the scripts it depends on
+function includeAssets(assets, bundles) {
+  const bundled = includeBundles(assets, bundles);
+  const pending = {};
+  assets.forEach(asset => {
+    if (bundled.includes(asset.type === 'css' ? 'css' : 'js')) {
+      return;
+    }
+    if (asset.type === 'css') {
+      handleEvent('includeCssFile', asset.url);
+      return;
+    }
+    const name = assetName(asset.url);
+    if (scriptLoadPromises[name] || document.querySelector(`script[src="${asset.url}"]`)) {
+      return;
+    }
+    const preload = document.createElement('link');
+    preload.rel = 'preload';
+    preload.as = 'script';
+    preload.href = asset.url;
+    document.head.appendChild(preload);
+    pending[name] = asset;
+  });
+
+  const started = {};
+  const start = (name, chain) => {
+    if (started[name]) {
+      return started[name];
+    }
+    if (chain.includes(name)) {
+      console.error(`includeAssets(): circular dependency on [${name}]`);
+      return Promise.resolve();
+    }
+    const asset = pending[name];
+    const deps = (asset.deps || []).map(dep => {
+      if (pending[dep]) {
+        return start(dep, chain.concat(name));
+      }
+      return scriptLoadPromises[dep] || Promise.resolve();
     });
+    started[name] = Promise.all(deps).then(() => new Promise((resolve) => {
+      const script = document.createElement('script');
+      script.src = asset.url;
+      script.async = false;
+      script.onload = () => {
+        debugLog(`Script [${asset.url}] loaded`);
+        delete scriptLoadPromises[name];
+        resolve();
+      };
+      script.onerror = () => {
+        console.error(`Failed to load script [${asset.url}]`);
+        delete scriptLoadPromises[name];
+        resolve();
+      };
+      document.body.appendChild(script);
+    }));
+    scriptLoadPromises[name] = started[name];
+    return started[name];
+  };
+  Object.keys(pending).forEach(name => start(name, []));
+}
 
-    ws.onclose = () => setTimeout(connect, 1000);
-} // connect()
+// Install the service worker the server offers, or remove one it no longer offers.
+// Browsers only run service workers on https or localhost.
+function updateServiceWorker(url) {
+  if (!('serviceWorker' in navigator)) {
+    return;
+  }
+  if (url) {
+    navigator.serviceWorker.register(url, { scope: '/' })
+      .catch(error => console.error('Service worker not registered:', error));
+  } else if (url === false) {
+    navigator.serviceWorker.getRegistrations()
+      .then(registrations => registrations.forEach(registration => registration.unregister()));
+  }
+}
 
-let scriptLoadPromises = {};  // Track script load status
+// Resolves as soon as [functionName] exists, so a call only waits for the script
+// that defines it (and the scripts that one depends on), not for every script
+function waitForFunction(functionName, pendingScripts) {
+  if (typeof window[functionName] === 'function') {
+    return Promise.resolve();
+  }
+  return new Promise((resolve) => {
+    let remaining = pendingScripts.length;
+    pendingScripts.forEach(promise => promise.finally(() => {
+      remaining--;
+      if (typeof window[functionName] === 'function' || remaining === 0) {
+        resolve();
+      }
+    }));
+  });
+}
 
 function handleEvent(eventType, data) 
 {
-  console.log('handleEvent() called with: '+ eventType + ', function: '+ data);
+  debugLog('handleEvent() called with: '+ eventType + ', function: '+ data);
   switch (eventType) {
     case 'callJsFunction':
+          // The function may read what the pending updates write
+          applyPendingUpdates();
           // Extract function name and parameters from the data object
           const functionName = data.data;
           const functionParams = data.params;
           
-          console.log('Handling callJsFunction(' + functionName + ')');
+          debugLog('Handling callJsFunction(' + functionName + ')');
           // Log the data and check the type
-          console.log('Data received:', functionName);
-          console.log('Parameters received:', functionParams);
+          debugLog('Data received:', functionName);
+          debugLog('Parameters received:', functionParams);
           
           if (typeof window[functionName] === 'undefined') {
             console.error('====>>> '+functionName+' is NOT a function')
           }
           else {
-            console.log('function ['+functionName+'] exists!')
+            debugLog('function ['+functionName+'] exists!')
           }
           
           // Check if we're waiting for any scripts to load
           const pendingScripts = Object.values(scriptLoadPromises);
           if (pendingScripts.length > 0) {
-              // Wait for all scripts to load before calling the function
-              Promise.all(pendingScripts).then(() => {
+              // Wait until the script that defines the function has run
+              waitForFunction(functionName, pendingScripts).then(() => {
                   if (typeof window[functionName] === 'function') {
-                      console.log('handleEvent(): Calling function:', functionName);
+                      debugLog('handleEvent(): Calling function:', functionName);
                       // Call the function with the parameter if it exists
                       if (functionParams !== undefined) {
                           window[functionName](functionParams);
@@ -333,7 +544,7 @@ function handleEvent(eventType, data)
           } else {
               // No pending scripts, call function immediately
               if (typeof window[functionName] === 'function') {
-                  console.log('handleEvent(): Calling function:', functionName);
+                  debugLog('handleEvent(): Calling function:', functionName);
                   // Call the function with the parameter if it exists
                   if (functionParams !== undefined) {
                       window[functionName](functionParams);
@@ -358,7 +569,7 @@ function handleEvent(eventType, data)
           }
           break;
       case 'includeJsFile':
-          console.log('Handling includeJsFile:', data);
+          debugLog('Handling includeJsFile:', data);
           // Ensure the script path starts with '/' and only includes the file name
           let jsFileName = data.split('/').pop();  // Extract the last part of the path
           if (jsFileName) {
@@ -369,7 +580,7 @@ function handleEvent(eventType, data)
               const script = document.createElement('script');
               script.src = data;
               script.onload = () => {
-                  console.log(`Script [${data}] loaded`);
+                  debugLog(`Script [${data}] loaded`);
                   delete scriptLoadPromises[data];  // Clean up
                   resolve();
               };
@@ -377,7 +588,7 @@ function handleEvent(eventType, data)
           });
           break;
           case 'includeCssFile':
-            console.log('Handling includeCssFile:', data);
+            debugLog('Handling includeCssFile:', data);
             // Ensure the script path starts with '/' and only includes the file name
             let cssFileName = data.split('/').pop();  // Extract the last part of the path
             if (cssFileName) {
@@ -389,19 +600,19 @@ function handleEvent(eventType, data)
                 link.rel = 'stylesheet';
                 link.href = data;
                 link.onload = () => {
-                    console.log(`CSS [${data}] loaded`);
+                    debugLog(`CSS [${data}] loaded`);
                 };
                 link.onerror = () => {
                     console.error(`Failed to load CSS [${data}]`);
                 };
                 document.head.appendChild(link);
             } else {
-                console.log(`CSS [${data}] is already included.`);
+                debugLog(`CSS [${data}] is already included.`);
             }
             break;
       case 'showPopup':
-          console.log('Handling showPopup:', data.id);
-          showPopup(data.id, data.content);
+          debugLog('Handling showPopup:', data.id);
+          openPopup(data);
           break;
       default:
           console.warn('Unhandled event type:', eventType);
@@ -410,6 +621,441 @@ function handleEvent(eventType, data)
 } // handleEvent()
 
 
+// [content] null: keep the page that is already there
+function showStreamedPage(content) {
+  const bodyContent = document.getElementById('bodyContent');
+  if (content !== null) {
+    renderPage(content);
+  }
+  bodyContent.style.display = 'block';
+  renderedPage = null;
+  flushDeferredFrames();
+}
+
+// Bring #bodyContent in line with [html], touching only the nodes that differ.
+// Elements with the same id are kept (and moved when needed), so focus, scroll
+// position and what the user is typing survive a page that is sent again.
+function renderPage(html) {
+  const template = document.createElement('template');
+  template.innerHTML = html;
+  morphChildren(document.getElementById('bodyContent'), template.content);
+}
+
+function nodeKey(node) {
+  return (node.nodeType === Node.ELEMENT_NODE) ? (node.id || node.getAttribute('data-key') || null) : null;
+}
+
+function morphChildren(fromParent, toParent) {
+  const keyed = new Map();
+  fromParent.childNodes.forEach(child => {
+    const key = nodeKey(child);
+    if (key !== null && !keyed.has(key)) {
+      keyed.set(key, child);
+    }
+  });
+
+  let cursor = fromParent.firstChild;
+  Array.from(toParent.childNodes).forEach(toChild => {
+    const key = nodeKey(toChild);
+    let match = null;
+    if (key !== null) {
+      match = keyed.get(key) || null;
+      if (match && match.nodeName !== toChild.nodeName) {
+        match = null;
+      }
+      keyed.delete(key);
+    } else if (cursor && nodeKey(cursor) === null && cursor.nodeName === toChild.nodeName) {
+      match = cursor;
+    }
+
+    if (match === null) {
+      fromParent.insertBefore(toChild, cursor);
+      return;
+    }
+    if (match === cursor) {
+      cursor = cursor.nextSibling;
+    } else {
+      fromParent.insertBefore(match, cursor);
+    }
+    morphNode(match, toChild);
+  });
+
+  // Whatever was not matched is gone from the new page
+  while (cursor) {
+    const next = cursor.nextSibling;
+    fromParent.removeChild(cursor);
+    cursor = next;
+  }
+}
+
+function morphNode(from, to) {
+  if (from.nodeType !== Node.ELEMENT_NODE) {
+    if (from.nodeValue !== to.nodeValue) {
+      from.nodeValue = to.nodeValue;
+    }
+    return;
+  }
+
+  for (let i = from.attributes.length - 1; i >= 0; i--) {
+    const name = from.attributes[i].name;
+    if (!to.hasAttribute(name)) {
+      from.removeAttribute(name);
+    }
+  }
+  for (const attribute of to.attributes) {
+    if (from.getAttribute(attribute.name) !== attribute.value) {
+      from.setAttribute(attribute.name, attribute.value);
+    }
+  }
+
+  // Leave the field the user is typing in alone
+  const editing = (from === document.activeElement);
+  if (from.tagName === 'INPUT') {
+    if (!editing && from.value !== to.value) {
+      from.value = to.value;
+    }
+    if (from.checked !== to.checked) {
+      from.checked = to.checked;
+    }
+    return;
+  }
+  if (from.tagName === 'TEXTAREA') {
+    if (!editing && from.value !== to.value) {
+      from.value = to.value;
+    }
+    return;
+  }
+  morphChildren(from, to);
+  if (from.tagName === 'SELECT' && !editing) {
+    from.value = to.value;
+  }
+}
+
+// One listener on #bodyContent for every input on every page, so nothing has to be
+// set up after a page is rendered
+function delegatePageEvents() {
+  document.getElementById('bodyContent').addEventListener('input', (event) => {
+    const input = event.target;
+    if (input.tagName !== 'INPUT' || !input.id || !ws || ws.readyState !== WebSocket.OPEN) {
+      return;
+    }
+    ws.send(JSON.stringify({
+        type: 'inputChange',
+        placeholder: input.id,
+        value: input.value
+    }));
+  });
+}
+
+// The server rendered the active page into SPAmanager.html: keep it like a streamed page,
+// so the server only has to confirm it when the WebSocket connects
+function keepRenderedPage() {
+  const bodyContent = document.getElementById('bodyContent');
+  if (!bodyContent.dataset.page || !bodyContent.dataset.digest) {
+    return;
+  }
+  renderedPage = { page: bodyContent.dataset.page, digest: bodyContent.dataset.digest };
+  cachePage(renderedPage.page, renderedPage.digest, bodyContent.innerHTML);
+}
+
+// Pages and popups are kept in memory and in localStorage, under their content digest
+function cacheContent(cache, prefix, name, digest, content) {
+  if (!name || !digest) {
+    return;
+  }
+  cache[name] = { digest: digest, content: content };
+  try {
+    localStorage.setItem(prefix + name, JSON.stringify(cache[name]));
+  } catch (error) {
+    // Storage full or disabled, the memory copy still works until a reload
+  }
+}
+
+function cachedContent(cache, prefix, name, digest) {
+  let entry = cache[name];
+  if (!entry) {
+    try {
+      entry = JSON.parse(localStorage.getItem(prefix + name));
+    } catch (error) {
+      entry = null;
+    }
+  }
+  return (entry && entry.digest === digest) ? entry.content : null;
+}
+
+function cachedDigests(cache, prefix) {
+  const digests = {};
+  Object.keys(cache).forEach(name => digests[name] = cache[name].digest);
+  try {
+    for (let i = 0; i < localStorage.length; i++) {
+      const key = localStorage.key(i);
+      if (key.startsWith(prefix) && !digests[key.substring(prefix.length)]) {
+        digests[key.substring(prefix.length)] = JSON.parse(localStorage.getItem(key)).digest;
+      }
+    }
+  } catch (error) {
+    // No localStorage
+  }
+  return digests;
+}
+
+function cachePage(page, digest, content) {
+  cacheContent(pageCache, PAGE_CACHE_PREFIX, page, digest, content);
+}
+
+function cachedPage(page, digest) {
+  return cachedContent(pageCache, PAGE_CACHE_PREFIX, page, digest);
+}
+
+function cachedPageDigests() {
+  return cachedDigests(pageCache, PAGE_CACHE_PREFIX);
+}
+
+// A popup template is parsed once, every open clones it
+function popupTemplate(id, digest, content) {
+  if (content !== undefined) {
+    cacheContent(popupCache, POPUP_CACHE_PREFIX, id, digest, content);
+  } else {
+    content = cachedContent(popupCache, POPUP_CACHE_PREFIX, id, digest);
+    if (content === null) {
+      return null;
+    }
+  }
+  const parsed = popupTemplates.get(id);
+  if (parsed && parsed.digest === digest) {
+    return parsed.template;
+  }
+  const template = document.createElement('template');
+  template.innerHTML = content;
+  popupTemplates.set(id, { digest: digest, template: template });
+  return template;
+}
+
+// Open a popup the server registered, with [data.values] filled in
+function openPopup(data) {
+  const template = popupTemplate(data.id, data.digest, data.content);
+  if (template === null) {
+    ws.send(JSON.stringify({ type: 'popupCacheMiss', id: data.id, values: data.values || {} }));
+    return;
+  }
+  showPopup(data.id, template.content.cloneNode(true));
+  // processAction() sends this key back, the server looks the popup up by it
+  const overlay = document.getElementById(data.id + '_overlay');
+  if (overlay && data.key !== undefined) {
+    overlay.dataset.key = data.key;
+  }
+  Object.entries(data.values || {}).forEach(([id, value]) => {
+    const element = document.getElementById(id);
+    if (!element) {
+      return;
+    }
+    if (element.tagName === 'INPUT' || element.tagName === 'TEXTAREA' || element.tagName === 'SELECT') {
+      element.value = value;
+    } else {
+      element.textContent = value;
+    }
+  });
+}
+
+function receiveGzipChunk(buffer) {
+  gzipChunks.push(buffer);
+  gzipReceived += buffer.byteLength;
+  updateLoadingProgress(gzipChunks.length, totalChunks);
+  if (gzipReceived < gzipSize) {
+    return;
+  }
+  
+  const stream = gzipStream;
+  const page = streamPage;
+  const digest = streamDigest;
+  const compressed = new Blob(gzipChunks);
+  gzipChunks = [];
+  gzipReceived = 0;
+  totalChunks = 0;
+  new Response(compressed.stream().pipeThrough(new DecompressionStream('gzip'))).text()
+    .then(content => {
+      // A newer page may have started while this one was decompressed
+      if (stream === gzipStream) {
+        cachePage(page, digest, content);
+        showStreamedPage(content);
+      }
+    })
+    .catch(error => console.error('Failed to decompress page:', error));
+}
+
+function scheduleAck() {
+  if (framesReceived - framesAcked >= 8) {
+    sendAck();
+  } else if (!ackTimer) {
+    ackTimer = setTimeout(sendAck, 200);
+  }
+}
+
+function sendAck() {
+  if (ackTimer) {
+    clearTimeout(ackTimer);
+    ackTimer = null;
+  }
+  if (framesReceived === framesAcked || !ws || ws.readyState !== WebSocket.OPEN) {
+    return;
+  }
+  framesAcked = framesReceived;
+  ws.send(JSON.stringify({ type: 'ack', frames: framesReceived }));
+}
+
+function deferFrame(data) {
+  if (!pageStreamPending) {
+    return false;
+  }
+  deferredFrames.push(data);
+  return true;
+}
+
+function flushDeferredFrames() {
+  pageStreamPending = false;
+  const frames = deferredFrames;
+  deferredFrames = [];
+  frames.forEach(data => {
+    if (data.event === 'callJsFunction') {
+      handleEvent('callJsFunction', data);
+    } else if (data.type === 'updates') {
+      data.updates.forEach(update => queueUpdate(update.target, update.content));
+    } else {
+      queueUpdate(data.target, data.content);
+    }
+  });
+}
+
+function queueUpdate(targetId, content) {
+  // Re-inserted, so targets are applied in the order of their last update
+  pendingUpdates.delete(targetId);
+  pendingUpdates.set(targetId, content);
+  if (!updateFrameRequested) {
+    updateFrameRequested = true;
+    requestAnimationFrame(applyPendingUpdates);
+  }
+}
+
+function applyPendingUpdates() {
+  updateFrameRequested = false;
+  const updates = pendingUpdates;
+  pendingUpdates = new Map();
+  updates.forEach((content, targetId) => applyUpdate(targetId, content));
+}
+
+// The worker parses the frames and merges the updates that arrive within one frame time
+// to the same target. Every other frame is passed back as it is, in the order it arrived.
+const FRAME_WORKER_SOURCE = `
+let updates = new Map();
+let timer = null;
+function flush() {
+  if (timer) {
+    clearTimeout(timer);
+    timer = null;
+  }
+  if (updates.size === 0) {
+    return;
+  }
+  const list = [];
+  updates.forEach((content, target) => list.push({ target: target, content: content }));
+  updates = new Map();
+  postMessage({ type: 'updates', updates: list });
+}
+function merge(target, content) {
+  updates.delete(target);
+  updates.set(target, content);
+  if (!timer) {
+    timer = setTimeout(flush, 16);
+  }
+}
+onmessage = (event) => {
+  if (event.data instanceof ArrayBuffer) {
+    flush();
+    postMessage(event.data, [event.data]);
+    return;
+  }
+  let data;
+  try {
+    data = JSON.parse(event.data);
+  } catch (error) {
+    postMessage({ type: 'workerError', message: error.message });
+    return;
+  }
+  if (data.type === 'update' && data.target !== 'title') {
+    merge(data.target, data.content);
+  } else if (data.type === 'updates') {
+    data.updates.forEach(update => merge(update.target, update.content));
+  } else {
+    flush();
+    postMessage(data);
+  }
+};
+`;
+
+function startFrameWorker() {
+  if (frameWorker || typeof Worker === 'undefined') {
+    return;
+  }
+  try {
+    const url = URL.createObjectURL(new Blob([FRAME_WORKER_SOURCE], { type: 'text/javascript' }));
+    frameWorker = new Worker(url);
+    URL.revokeObjectURL(url);
+  } catch (error) {
+    console.error('Frame worker not started, parsing frames on the main thread:', error);
+    frameWorker = null;
+    return;
+  }
+  frameWorker.onmessage = (event) => {
+    if (event.data instanceof ArrayBuffer) {
+      receiveGzipChunk(event.data);
+    } else if (event.data.type === 'workerError') {
+      console.error('Error parsing message:', event.data.message);
+    } else {
+      handleFrame(event.data);
+    }
+  };
+}
+
+function stopFrameWorker() {
+  if (frameWorker) {
+    frameWorker.terminate();
+    frameWorker = null;
+  }
+}
+
+function applyClientOptions(options) {
+  logLevel = (typeof options.logLevel === 'number') ? options.logLevel : LOG_DEBUG;
+  if (options.worker) {
+    startFrameWorker();
+  } else {
+    stopFrameWorker();
+  }
+}
+
+function loadClientOptions() {
+  try {
+    const options = JSON.parse(localStorage.getItem(CLIENT_OPTIONS_KEY));
+    if (options) {
+      applyClientOptions(options);
+    }
+  } catch (error) {
+    // No localStorage, the server sends the options when we connect
+  }
+}
+
+function applyUpdate(targetId, content) {
+  const target = document.getElementById(targetId);
+  if (target) {
+    if (targetId === 'bodyContent') {
+        renderPage(content);
+    } else if (target.tagName === 'INPUT') {
+        target.value = content;
+    } else {
+        target.textContent = content;
+    }
+  }
+}
+
 function enableMenuItem(pageName, menuName, itemName) {
   const menuItems = document.querySelectorAll(`[data-menu="${menuName}"][data-item="${itemName}"]`);
   menuItems.forEach(item => {
@@ -418,7 +1064,8 @@ function enableMenuItem(pageName, menuName, itemName) {
       if (item.tagName === 'A') {
           item.style.pointerEvents = '';
       } else {
-          item.onclick = () => handleMenuClick(menuName, itemName);
+          const itemId = (item.dataset.id !== undefined) ? Number(item.dataset.id) : undefined;
+          item.onclick = () => handleMenuClick(menuName, itemName, itemId);
       }
   });
 }
@@ -441,17 +1088,6 @@ function setPlaceholder(pageName, placeholder, value) {
   if (element) {
       if (element.tagName === 'INPUT') {
           element.value = value;
-          // Add input event listener if not already added
-          if (!element.hasInputListener) {
-              element.addEventListener('input', () => {
-                  ws.send(JSON.stringify({
-                      type: 'inputChange',
-                      placeholder: placeholder,
-                      value: element.value
-                  }));
-              });
-              element.hasInputListener = true;
-          }
       } else {
           element.textContent = value;
       }
@@ -461,22 +1097,8 @@ function setPlaceholder(pageName, placeholder, value) {
 function activatePage(pageName) {
   if (pages[pageName]) {
       const bodyContent = document.getElementById('bodyContent');
-      bodyContent.innerHTML = pages[pageName];
+      renderPage(pages[pageName]);
       bodyContent.style.display = 'block';
-      
-      // Add input listeners to all input fields
-      document.querySelectorAll('input[id]').forEach(input => {
-          if (!input.hasInputListener) {
-              input.addEventListener('input', () => {
-                  ws.send(JSON.stringify({
-                      type: 'inputChange',
-                      placeholder: input.id,
-                      value: input.value
-                  }));
-              });
-              input.hasInputListener = true;
-          }
-      });
   }
 }
 
@@ -516,12 +1138,20 @@ function updateDateTime() {
 }
 
 window.onload = function() {
+  loadClientOptions();
+  delegatePageEvents();
+  keepRenderedPage();
   connect();
   updateDateTime();
   setInterval(updateDateTime, 1000);
 };
 
-function handleMenuClick(menuName, itemName) {
+// The server finds the item by the id it gave it, the names are only needed without one
+function handleMenuClick(menuName, itemName, itemId) {
+  if (itemId !== undefined) {
+    ws.send(JSON.stringify({ type: 'menuClick', id: itemId }));
+    return;
+  }
   ws.send(JSON.stringify({
       type: 'menuClick',
       menu: menuName,
@@ -538,7 +1168,7 @@ function includeJsFile(fileName) {
         script.defer = false;  // Ensure immediate execution
         
         script.onload = () => {
-          console.log(`Script [${fileName}] loaded and executed`);
+          debugLog(`Script [${fileName}] loaded and executed`);
           resolve();
         };
         
@@ -549,9 +1179,9 @@ function includeJsFile(fileName) {
         
         // Insert at the head to ensure it loads before other scripts
         document.head.appendChild(script);
-        console.log(`Including JS script: [${fileName}]`);
+        debugLog(`Including JS script: [${fileName}]`);
     } else {
-        console.log(`Script [${fileName}] is already included.`);
+        debugLog(`Script [${fileName}] is already included.`);
         resolve();
     }
   });
@@ -559,11 +1189,11 @@ function includeJsFile(fileName) {
 
 // Define closePopup as a standalone function
 window.closePopup = function(popupId) {
-  console.log(`Closing popup: ${popupId}`);
+  debugLog(`Closing popup: ${popupId}`);
   
   // Clear any active countdown timer
   if (window.popupCountdownInterval) {
-      console.log('Clearing countdown interval');
+      debugLog('Clearing countdown interval');
       clearInterval(window.popupCountdownInterval);
       window.popupCountdownInterval = null;
   }
@@ -576,7 +1206,7 @@ window.closePopup = function(popupId) {
 
 // Function to handle popup windows
 function showPopup(id, content) {
-  console.log(`Showing popup: ${id}, with content:`, content);
+  debugLog(`Showing popup: ${id}, with content:`, content);
   
   // Remove any existing popup first
   const existingOverlay = document.querySelector('.dM_popup-overlay');
@@ -598,7 +1228,12 @@ function showPopup(id, content) {
   popupContent.className = 'dM_popup-content';
   popupContent.id = id + '_content';
   
-  popupContent.innerHTML = content;
+  // A string, or the clone of a popup template
+  if (typeof content === 'string') {
+    popupContent.innerHTML = content;
+  } else {
+    popupContent.appendChild(content);
+  }
   
   // Handle file upload if present
   const fileInput = popupContent.querySelector('input[type="file"]');
@@ -612,7 +1247,7 @@ function showPopup(id, content) {
               // Enable upload button
               if (uploadButton) {
                   uploadButton.disabled = false;
-                  console.log('Upload button enabled');
+                  debugLog('Upload button enabled');
               }
               
               // Display selected filename
@@ -698,7 +1333,7 @@ function showPopup(id, content) {
 } // showPopup()
 
 function processAction(processType) {
-  console.log('Processing action:', processType);
+  debugLog('Processing action:', processType);
 
   // Get the popup ID - FIXED: Use the correct class name
   const popupOverlay = document.querySelector('.dM_popup-overlay');
@@ -708,16 +1343,16 @@ function processAction(processType) {
   const inputValues = {};
   if (popupOverlay) {
     const inputs = popupOverlay.querySelectorAll('input');
-    console.log('Found', inputs.length, 'input fields in popup');
+    debugLog('Found', inputs.length, 'input fields in popup');
     inputs.forEach(input => {
       if (input.id) {
         // Special handling for color inputs to ensure the color value is correctly captured
         if (input.type === 'color') {
           inputValues[input.id] = input.value;
-          console.log('Collected color value:', input.id, '=', input.value);
+          debugLog('Collected color value:', input.id, '=', input.value);
         } else {
           inputValues[input.id] = input.value;
-          console.log('Collected input value:', input.id, '=', input.value);
+          debugLog('Collected input value:', input.id, '=', input.value);
         }
       }
     });
@@ -729,9 +1364,10 @@ function processAction(processType) {
     type: 'process',
     processType: processType,
     popupId: popupId,
+    popupKey: (popupOverlay && popupOverlay.dataset.key !== undefined) ? Number(popupOverlay.dataset.key) : undefined,
     inputValues: inputValues
   };
-  console.log('Sending WebSocket message:', JSON.stringify(message));
+  debugLog('Sending WebSocket message:', JSON.stringify(message));
 
 ws.send(JSON.stringify(message));
 
@@ -739,13 +1375,13 @@ ws.send(JSON.stringify(message));
 
 function javaFunctionWithParams(param1) 
 {
-  console.log('Java function called with params[', param1, ']');
+  debugLog('Java function called with params[', param1, ']');
 
 } // javaFunctionWithParams(param1)
 
 function javaFunctionWithoutParams() 
 {
-  console.log('Java function called without params');
+  debugLog('Java function called without params');
   
 } // javaFunctionWithoutParams()
 
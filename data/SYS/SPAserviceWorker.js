@@ -0,0 +1,126 @@
+// Service worker of the SPAmanager, served as /spa-sw.js when enableServiceWorker(true) is set.
+// Keeps the app shell (html, css, js and included files) in a cache named after the version
+// in /spa-assets.json, so a reload does not need the device. Only the WebSocket reconnects.
+
+const CACHE_PREFIX = 'spa-shell-';
+const MANIFEST_URL = '/spa-assets.json';
+const REVALIDATE_INTERVAL = 60 * 1000;  // Ask the device for a new manifest at most once a minute
+let lastRevalidate = 0;
+let activeCacheName = null;  // The complete cache of the current version, found again after a restart
+
+async function fetchManifest() {
+  const response = await fetch(MANIFEST_URL, { cache: 'no-store' });
+  if (!response.ok) {
+    throw new Error(`${MANIFEST_URL}: ${response.status}`);
+  }
+  return response.json();
+}
+
+// Fill a cache for this version and drop the caches of older versions
+async function installShell(manifest) {
+  const cacheName = CACHE_PREFIX + manifest.version;
+  if (!(await isComplete(cacheName))) {
+    const cache = await caches.open(cacheName);
+    try {
+      // One file at a time, the device serves one request at a time anyway
+      for (const url of manifest.assets) {
+        await cache.add(new Request(url, { cache: 'no-cache' }));
+      }
+      // Put last: a cache holding its own manifest is complete. Also tells how to answer "/"
+      await cache.put(MANIFEST_URL, new Response(JSON.stringify(manifest)));
+    } catch (error) {
+      await caches.delete(cacheName);
+      throw error;
+    }
+  }
+  activeCacheName = cacheName;
+  const names = await caches.keys();
+  await Promise.all(names.filter(name => name.startsWith(CACHE_PREFIX) && name !== cacheName)
+                         .map(name => caches.delete(name)));
+}
+
+async function revalidate() {
+  if (Date.now() - lastRevalidate < REVALIDATE_INTERVAL) {
+    return;
+  }
+  lastRevalidate = Date.now();
+  try {
+    await installShell(await fetchManifest());
+  } catch (error) {
+    console.log('SPAserviceWorker: keeping the cached shell,', error.message);
+  }
+}
+
+// True when the cache holds the manifest of the version it is named after
+async function isComplete(cacheName) {
+  if (!(await caches.has(cacheName))) {
+    return false;
+  }
+  const response = await (await caches.open(cacheName)).match(MANIFEST_URL);
+  if (!response) {
+    return false;
+  }
+  try {
+    return CACHE_PREFIX + (await response.json()).version === cacheName;
+  } catch (error) {
+    return false;
+  }
+}
+
+async function currentCache() {
+  if (activeCacheName && !(await caches.has(activeCacheName))) {
+    activeCacheName = null;
+  }
+  // A restarted worker looks for the cache that was completed, not for any cache
+  if (!activeCacheName) {
+    for (const name of await caches.keys()) {
+      if (name.startsWith(CACHE_PREFIX) && await isComplete(name)) {
+        activeCacheName = name;
+        break;
+      }
+    }
+  }
+  return activeCacheName ? caches.open(activeCacheName) : null;
+}
+
+async function rendersRoot(cache) {
+  const response = await cache.match(MANIFEST_URL);
+  return response ? (await response.json()).rendersRoot === true : false;
+}
+
+self.addEventListener('install', (event) => {
+  event.waitUntil(fetchManifest().then(installShell).then(() => self.skipWaiting()));
+});
+
+self.addEventListener('activate', (event) => {
+  event.waitUntil(self.clients.claim());
+});
+
+self.addEventListener('fetch', (event) => {
+  const url = new URL(event.request.url);
+  if (event.request.method !== 'GET' || url.origin !== self.location.origin || url.pathname === MANIFEST_URL) {
+    return;
+  }
+  // The root is the shell, the page itself arrives over the WebSocket
+  const key = (url.pathname === '/') ? '/SPAmanager.html' : url.pathname + url.search;
+
+  event.respondWith((async () => {
+    const cache = await currentCache();
+    // A device that renders the page into "/" is asked first, the cached shell is the fallback
+    if (url.pathname === '/' && cache && await rendersRoot(cache)) {
+      try {
+        return await fetch(event.request);
+      } catch (error) {
+        return (await cache.match(key)) || Response.error();
+      }
+    }
+    const cached = cache ? await cache.match(key) : undefined;
+    if (!cached) {
+      return fetch(event.request);
+    }
+    if (event.request.mode === 'navigate') {
+      event.waitUntil(revalidate());
+    }
+    return cached;
+  })());
+});
@@ -5,6 +5,12 @@
 #include <WebSocketsServer.h>
 #include <WiFiManager.h>
 #include "SPAmanager.h"
+//-- Generated from pages/AboutPage.html by compile_pages.py (a PlatformIO pre: script),
+//-- without it (Arduino IDE, clean checkout) the demo runs without the About page
+#if __has_include("SPApages.h")
+  #include "SPApages.h"
+  #define HAS_COMPILED_PAGES
+#endif
 
 #define CLOCK_UPDATE_INTERVAL  1000
 
@@ -32,6 +38,13 @@ void mainCallback2()
 
 } // mainCallback2()
 
+void mainCallback3()
+{
+    spa.setPlaceholder("AboutPage", "aboutCounter", counter);
+    spa.activatePage("AboutPage");
+
+} // mainCallback3()
+
 void startCounterCallback()
 {
     spa.setMessage("Counter: Start clicked!", 3);
@@ -71,6 +84,12 @@ void exitCounterCallback()
 
 } // exitCounterCallback()
 
+void exitAboutCallback()
+{
+    spa.activatePage("Main");
+
+} // exitAboutCallback()
+
 
 void handleInputMenu(const char* param)
 {
@@ -114,6 +133,9 @@ void setupMainPage()
     spa.addMenu("Main", "Main Menu");
     spa.addMenuItem("Main", "Main Menu", "Counter", mainCallback1);
     spa.addMenuItem("Main", "Main Menu", "InputTest", mainCallback2);
+#ifdef HAS_COMPILED_PAGES
+    spa.addMenuItem("Main", "Main Menu", "About", mainCallback3);
+#endif
     spa.addMenuItem("Main", "Main Menu", "Item3", "/");
 
 } // setupMainPage()
@@ -175,6 +197,19 @@ void setupInputPage()
 } // setupInputPage()
 
 
+#ifdef HAS_COMPILED_PAGES
+void setupAboutPage()
+{
+    spa.addCompiledPage(spaPage_AboutPage);
+    spa.setPageTitle("AboutPage", "About");
+    //-- Add About menu
+    spa.addMenu("AboutPage", "About");
+    spa.addMenuItem("AboutPage", "About", "Exit", exitAboutCallback);
+
+} // setupAboutPage()
+#endif
+
+
 void updateCounter() 
 {
     if (millis() - lastCounterUpdate >= CLOCK_UPDATE_INTERVAL) 
@@ -207,6 +242,9 @@ void setup()
     setupMainPage();
     setupCounterPage();
     setupInputPage();
+#ifdef HAS_COMPILED_PAGES
+    setupAboutPage();
+#endif
     spa.activatePage("Main");
     
     Serial.println("Done with setup() ..\n");
@@ -216,8 +254,7 @@ void setup()
 
 void loop()
 {
-    spa.server.handleClient();
-    spa.ws.loop();
+    spa.loop();
     updateCounter();
 
 } // loop()
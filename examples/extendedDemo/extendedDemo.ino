@@ -448,8 +448,7 @@ void setup()
 void loop()
 {
   network->loop();
-  spa.server.handleClient();
-  spa.ws.loop();
+  spa.loop();
   updateCounter();
 
   static uint32_t testTimer = 0;
@@ -0,0 +1,176 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <SD.h>
+#include <WiFi.h>
+#include <WebSocketsClient.h>
+#include "SPAmanager.h"
+#include "SPAstorage.h"
+
+//-- Compares the page storage backends through the SPAmanager itself:
+//--   addPage()        writes the page through the backend
+//--   page stream      the SPAmanager reads the page in 1023 byte chunks and sends them
+//--                    to a WebSocket client on this ESP32 (over the soft-AP loopback)
+//--   setPlaceholder() rewrites the page through a temporary file
+//-- The asset cache is turned off, so every stream reads the backend.
+//-- The POSIX backend needs an SD card, it reads and writes FAT through the ESP-IDF VFS.
+//-- LittleFS through the VFS would only measure the LittleFS backend a second time.
+
+#define PAGE_SIZE     (16 * 1024)
+#define STREAM_RUNS   20
+#define UPDATE_RUNS   20
+#define WAIT_MS       10000
+
+SPAmanager spa(80);
+WebSocketsClient benchClient;
+
+SPAfsStorage    littleFSstorage(LittleFS);
+SPAramStorage   ramStorage;
+SPAposixStorage posixStorage("/sd");  // Where SD.begin() mounts the card
+
+bool clientConnected = false;
+bool streamDone = false;
+
+
+void benchClientEvent(WStype_t type, uint8_t* payload, size_t length)
+{
+    if (type == WStype_CONNECTED) {
+        clientConnected = true;
+    } else if (type == WStype_DISCONNECTED) {
+        clientConnected = false;
+    } else if (type == WStype_TEXT) {
+        // Quotes inside the page content are escaped, so these only match the frame itself
+        if (strstr((const char*)payload, "\"type\":\"pageChunk\"") && strstr((const char*)payload, "\"final\":true")) {
+            streamDone = true;
+        }
+    }
+
+} // benchClientEvent()
+
+
+//-- Run the server and the client until flag is set
+bool runUntil(const bool& flag, uint32_t timeoutMs = WAIT_MS)
+{
+    uint32_t start = millis();
+    while (!flag) {
+        if (millis() - start > timeoutMs) {
+            return false;
+        }
+        spa.loop();
+        benchClient.loop();
+        yield();
+    }
+    return true;
+
+} // runUntil()
+
+
+//-- Let the SPAmanager send what is still queued
+void runFor(uint32_t durationMs)
+{
+    uint32_t start = millis();
+    while (millis() - start < durationMs) {
+        spa.loop();
+        benchClient.loop();
+        yield();
+    }
+
+} // runFor()
+
+
+std::string benchPage()
+{
+    std::string page;
+    while (page.length() < PAGE_SIZE) {
+        page += "<div id='value" + std::to_string(page.length()) + "'>0</div>\n";
+    }
+    return page;
+
+} // benchPage()
+
+
+void benchmark(const char* name, SPAstorage& storage)
+{
+    //-- Every backend gets its own page, the pages of the previous backend are not used again
+    std::string pageName = std::string("bench") + name;
+    std::string page = benchPage();
+    spa.setStorage(storage);
+
+    uint32_t start = micros();
+    spa.addPage(pageName.c_str(), page.c_str());
+    uint32_t addMicros = micros() - start;
+    if (!spa.pageExists(pageName.c_str())) {
+        Serial.printf("%-8s: addPage() failed\n", name);
+        return;
+    }
+
+    //-- The first stream follows the activation, the next ones are asked for as a cache miss
+    std::string cacheMiss = "{\"type\":\"pageCacheMiss\",\"page\":\"" + pageName + "\"}";
+    uint32_t streamMicros = 0;
+    int streams = 0;
+    for (int i = 0; i < STREAM_RUNS; i++) {
+        streamDone = false;
+        start = micros();
+        if (i == 0) {
+            spa.activatePage(pageName.c_str());
+        } else {
+            benchClient.sendTXT(cacheMiss.c_str());
+        }
+        if (!runUntil(streamDone)) {
+            break;
+        }
+        streamMicros += micros() - start;
+        streams++;
+    }
+
+    uint32_t updateMicros = 0;
+    for (int i = 0; i < UPDATE_RUNS; i++) {
+        start = micros();
+        spa.setPlaceholder(pageName.c_str(), "value0", i);
+        updateMicros += micros() - start;
+        runFor(20);  // Send the update frame before the next one merges with it
+    }
+
+    Serial.printf("%-8s: addPage %6.1f ms, stream %7.1f KB/s (%d of %d), setPlaceholder %6.1f ms\n", name,
+                    addMicros / 1000.0,
+                    streams ? (streams * page.length() / 1024.0) / (streamMicros / 1000000.0) : 0.0,
+                    streams, STREAM_RUNS,
+                    updateMicros / 1000.0 / UPDATE_RUNS);
+
+} // benchmark()
+
+
+void setup()
+{
+    Serial.begin(115200);
+    delay(3000);
+    LittleFS.begin(true);
+
+    //-- The benchmark client connects to this ESP32, no other network is needed
+    WiFi.softAP("storageBench");
+    spa.begin("/SYS");
+    spa.setAssetCacheBudget(0);
+    benchClient.onEvent(benchClientEvent);
+    benchClient.begin(WiFi.softAPIP().toString().c_str(), 81, "/");
+    if (!runUntil(clientConnected)) {
+        Serial.println("The benchmark client could not connect");
+        return;
+    }
+
+    Serial.printf("Page of %u bytes, %d streams, %d updates\n", PAGE_SIZE, STREAM_RUNS, UPDATE_RUNS);
+    benchmark("LittleFS", littleFSstorage);
+    benchmark("RAM", ramStorage);
+    if (SD.begin()) {
+        benchmark("POSIX", posixStorage);
+    } else {
+        Serial.println("POSIX   : no SD card, skipped");
+    }
+    Serial.println("Done with setup() ..\n");
+
+} // setup()
+
+
+void loop()
+{
+    delay(1000);
+
+} // loop()
@@ -0,0 +1,134 @@
+#include <Arduino.h>
+#include "SPAvalueStore.h"
+
+//-- Measures the value store on a RAM backed flash simulator:
+//-- write amplification, replay time and recovery after a power loss.
+//-- SPAvalueStore.cpp has no Arduino dependencies, so the same code runs on a Linux host.
+
+#define FLASH_SIZE     (64 * 1024)
+#define VALUE_UPDATES  5000
+#define PAGE_SIZE      2048   // A page file that would be rewritten for every change
+
+const char* keys[] = { "Main/clock", "Main/temperature", "Counter/counter", "Counter/counterState",
+                       "InputPage/input1", "InputPage/input2", "InputPage/input3" };
+const size_t keyCount = sizeof(keys) / sizeof(keys[0]);
+
+
+void fillStore(SPAvalueStore& store, uint32_t updates, uint32_t firstValue = 0)
+{
+    for (uint32_t i = 0; i < updates; i++)
+    {
+        store.set(keys[i % keyCount], std::to_string(firstValue + i));
+    }
+
+} // fillStore()
+
+
+void benchmarkWriteAmplification()
+{
+    SPAramFlash flash(FLASH_SIZE);
+    SPAvalueStore store;
+    store.begin(flash);
+    flash.resetStats();
+
+    fillStore(store, VALUE_UPDATES);
+
+    const SPAvalueStore::Stats& stats = store.getStats();
+    Serial.printf("Write amplification after %u updates\n", VALUE_UPDATES);
+    Serial.printf("  payload      : %u bytes\n", stats.payloadBytes);
+    Serial.printf("  flash written: %u bytes (%.2fx)\n", flash.getStats().bytesWritten,
+                    (float)flash.getStats().bytesWritten / stats.payloadBytes);
+    Serial.printf("  sectors erased: %u, compactions: %u\n", flash.getStats().sectorsErased, stats.compactions);
+    Serial.printf("  rewriting a %u byte page per update: %.2fx\n", PAGE_SIZE,
+                    (float)PAGE_SIZE * VALUE_UPDATES / stats.payloadBytes);
+
+} // benchmarkWriteAmplification()
+
+
+void benchmarkReplay()
+{
+    SPAramFlash flash(FLASH_SIZE);
+    SPAvalueStore store;
+    store.begin(flash);
+    // Stop just before the bank is full, so the replay reads the longest possible log
+    while (store.getStats().logUsed + 64 < store.getStats().logSize)
+    {
+        fillStore(store, 1, store.getStats().logUsed);
+    }
+
+    SPAvalueStore replayed;
+    uint32_t start = micros();
+    replayed.begin(flash);
+    uint32_t elapsed = micros() - start;
+    Serial.printf("Replay of %u records (%u bytes): %u us\n", replayed.getStats().replayedRecords,
+                    replayed.getStats().logUsed, elapsed);
+
+} // benchmarkReplay()
+
+
+void benchmarkPowerLoss()
+{
+    uint32_t runs = 0;
+    uint32_t recovered = 0;
+
+    // Cut the power after a growing number of bytes, covering appends and compactions
+    for (size_t cut = 0; cut < FLASH_SIZE / 2; cut += 97)
+    {
+        SPAramFlash flash(FLASH_SIZE);
+        SPAvalueStore store;
+        store.begin(flash);
+        fillStore(store, 500);
+
+        std::map<std::string, std::string> expected;
+        store.forEach("", [&expected](const std::string& key, const std::string& value) { expected[key] = value; });
+
+        flash.failAfterBytes(cut);
+        std::string lastKey;
+        std::string lastValue;
+        for (uint32_t i = 500; flash.isPowered(); i++)
+        {
+            lastKey = keys[i % keyCount];
+            lastValue = std::to_string(i);
+            if (store.set(lastKey, lastValue))
+            {
+                expected[lastKey] = lastValue;
+            }
+        }
+        flash.powerCycle();
+
+        // Every value must be the last one written, only the interrupted one may be either
+        SPAvalueStore rebooted;
+        bool valid = rebooted.begin(flash);
+        for (const auto& entry : expected)
+        {
+            std::string value;
+            valid = valid && rebooted.get(entry.first, value)
+                          && (value == entry.second || (entry.first == lastKey && value == lastValue));
+        }
+        runs++;
+        recovered += valid ? 1 : 0;
+    }
+    Serial.printf("Power loss: %u of %u runs recovered\n", recovered, runs);
+
+} // benchmarkPowerLoss()
+
+
+void setup()
+{
+    Serial.begin(115200);
+    delay(3000);
+
+    benchmarkWriteAmplification();
+    benchmarkReplay();
+    benchmarkPowerLoss();
+
+    Serial.println("Done with setup() ..\n");
+
+} // setup()
+
+
+void loop()
+{
+    delay(1000);
+
+} // loop()
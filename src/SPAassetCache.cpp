@@ -0,0 +1,131 @@
+//----- SPAassetCache.cpp -----
+#include "SPAassetCache.h"
+#include <stdlib.h>
+#include <iterator>
+
+#ifdef ESP32
+  #include <esp_heap_caps.h>
+#endif
+
+
+SPAassetCache::Content::Content(size_t size) : data(nullptr), size(size)
+{
+#ifdef ESP32
+    if (usesPsram()) {
+        data = (char*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+#endif
+    if (!data) {
+        data = (char*)malloc(size);
+    }
+    if (!data) {
+        this->size = 0;
+    }
+
+} // Content()
+
+SPAassetCache::Content::~Content()
+{
+    free(data);
+
+} // ~Content()
+
+
+bool SPAassetCache::usesPsram()
+{
+#ifdef ESP32
+    return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#else
+    return false;
+#endif
+
+} // usesPsram()
+
+
+void SPAassetCache::setBudget(size_t budget, size_t maxEntrySize)
+{
+    stats.budget = budget;
+    this->maxEntrySize = maxEntrySize ? maxEntrySize : budget / 4;
+    while (!slots.empty() && stats.bytesUsed > stats.budget) {
+        evict(std::prev(slots.end()));
+    }
+
+} // setBudget()
+
+
+SPAassetCache::Entry SPAassetCache::get(const std::string& key)
+{
+    auto it = index.find(key);
+    if (it == index.end()) {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    slots.splice(slots.begin(), slots, it->second);
+    return it->second->content;
+
+} // get()
+
+
+std::shared_ptr<SPAassetCache::Content> SPAassetCache::put(const std::string& key, size_t size)
+{
+    remove(key);
+    if (!accepts(size)) {
+        // An empty file, or a cache that is turned off, is not a rejection
+        if (size > 0 && stats.budget > 0) {
+            stats.rejected++;
+        }
+        return nullptr;
+    }
+    // Drop the least recently used files until the new one fits
+    while (!slots.empty() && stats.bytesUsed + size > stats.budget) {
+        evict(std::prev(slots.end()));
+    }
+    std::shared_ptr<Content> content = std::make_shared<Content>(size);
+    if (content->size != size) {
+        stats.rejected++;
+        return nullptr;
+    }
+    slots.push_front({key, content});
+    index[key] = slots.begin();
+    stats.bytesUsed += size;
+    stats.entries = slots.size();
+    return content;
+
+} // put()
+
+
+void SPAassetCache::remove(const std::string& key)
+{
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+    stats.bytesUsed -= it->second->content->size;
+    slots.erase(it->second);
+    index.erase(it);
+    stats.entries = slots.size();
+
+} // remove()
+
+
+void SPAassetCache::clear()
+{
+    slots.clear();
+    index.clear();
+    stats.bytesUsed = 0;
+    stats.entries = 0;
+
+} // clear()
+
+
+// a stream that still uses the content keeps it alive until it is done
+void SPAassetCache::evict(std::list<Slot>::iterator slot)
+{
+    stats.bytesUsed -= slot->content->size;
+    stats.evictions++;
+    index.erase(slot->key);
+    slots.erase(slot);
+    stats.entries = slots.size();
+
+} // evict()
@@ -0,0 +1,62 @@
+#ifndef SPA_ASSET_CACHE_H
+#define SPA_ASSET_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+
+//-- Keeps the most recently used small files in RAM, within a byte budget.
+//-- On an ESP32 with PSRAM the contents are kept in PSRAM.
+class SPAassetCache
+{
+  public:
+    struct Content
+    {
+      Content(size_t size);
+      ~Content();
+      char* data;
+      size_t size;
+    };
+    typedef std::shared_ptr<const Content> Entry;
+
+    struct Stats
+    {
+      uint32_t hits = 0;
+      uint32_t misses = 0;
+      uint32_t evictions = 0;
+      uint32_t rejected = 0;      // Files that were too large to cache
+      size_t bytesUsed = 0;
+      size_t budget = 0;
+      size_t entries = 0;
+    };
+
+    //-- [maxEntrySize] 0: a quarter of the budget. A budget of 0 turns the cache off.
+    void setBudget(size_t budget, size_t maxEntrySize = 0);
+    bool accepts(size_t size) const { return size > 0 && size <= maxEntrySize && size <= stats.budget; }
+    //-- A cached file, or nullptr (counted as a miss)
+    Entry get(const std::string& key);
+    //-- Make room and allocate a new entry for [key], fill its data before the next call
+    std::shared_ptr<Content> put(const std::string& key, size_t size);
+    void remove(const std::string& key);
+    void clear();
+    const Stats& getStats() const { return stats; }
+    static bool usesPsram();
+
+  private:
+    struct Slot
+    {
+      std::string key;
+      std::shared_ptr<Content> content;
+    };
+    void evict(std::list<Slot>::iterator slot);
+
+    std::list<Slot> slots;   // Most recently used first
+    std::map<std::string, std::list<Slot>::iterator> index;
+    size_t maxEntrySize = 0;
+    Stats stats;
+};
+
+#endif // SPA_ASSET_CACHE_H
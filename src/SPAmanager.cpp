@@ -6,6 +6,7 @@
 #include <WString.h>
 
 const char* SPAmanager::PAGES_DIRECTORY = "/SPApages/";
+const char* SPAmanager::PAGE_DIGESTS_FILE = "/SPApages/pages.idx";
 
 const char* SPAmanager::DEFAULT_ERROR_PAGE = R"HTML(
   <div style="text-align: center; padding: 20px;">
@@ -41,6 +42,7 @@ SPAmanager::SPAmanager(uint16_t port)
     , servedFiles()  // Initialize empty set
 {
   debug(("SPAmanager::  constructor called with port: " + std::to_string(port)).c_str());
+  assetCache.setBudget(SPAassetCache::usesPsram() ? ASSET_CACHE_BUDGET_PSRAM : ASSET_CACHE_BUDGET);
 }
 
 
@@ -63,16 +65,23 @@ void SPAmanager::begin(const char* systemPath, Stream* debugOut)
     rootSystemPath = path;
 
     this->debugOut = debugOut;
+    bootTimings.beginAtMs = millis();
 
     debug(("SPAmanager::begin: called with rootSystemPath: [" + rootSystemPath + "]").c_str());
         
     setupWebServer();
 
+    bootTimings.readyAtMs = millis();
+    debug(("begin(): manifest " + std::to_string(bootTimings.manifestUs) + "us, checks " + std::to_string(bootTimings.checkUs)
+            + "us, routes " + std::to_string(bootTimings.routesUs) + "us, server.begin() " + std::to_string(bootTimings.serverStartUs)
+            + "us, ready " + std::to_string(bootTimings.readyAtMs) + "ms after power-on").c_str());
+
 } //  begin()
 
 void SPAmanager::setupWebServer() 
 {
     debug("setupWebServer() called");
+    uint32_t phaseStart = micros();
     ws.begin();
     ws.onEvent([this](uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
         handleWebSocketEvent(num, type, payload, length);
@@ -88,74 +97,89 @@ void SPAmanager::setupWebServer()
     debug(msg.c_str());
 
     // Serve system files
-    std::string sysPath = rootSystemPath;
-    if (sysPath[0] != '/') {
-        sysPath = "/" + sysPath; // Ensure it starts with a slash
-    }
-    // Debug the system path
+    std::string sysPath = normalizePath(rootSystemPath);
     debug(("System path: [" + sysPath + "]").c_str());
-    
-    // Check if the system directory exists
-    if (!LittleFS.exists(sysPath.c_str())) {
+    bootTimings.routesUs = micros() - phaseStart;
+
+    phaseStart = micros();
+    bool haveManifest = loadAssetManifest(sysPath);
+    bootTimings.manifestUs = micros() - phaseStart;
+
+    static const char* systemFiles[] = { "SPAmanager.html", "SPAmanager.css", "SPAmanager.js", "disconnected.html" };
+    phaseStart = micros();
+    if (haveManifest) {
+        // The manifest lists what the filesystem image holds, files are checked when first used
+        for (const char* name : systemFiles) {
+            if (assetManifest.find(sysPath + "/" + name) == assetManifest.end()) {
+                error(("System file not in asset manifest: " + sysPath + "/" + name).c_str());
+            }
+        }
+    } else if (!fileExists(sysPath)) {
         error(("System directory does not exist: " + sysPath).c_str());
         
         // Try to list all directories in the root to help debug
-        File root = LittleFS.open("/", "r");
-        if (root && root.isDirectory()) {
-            File file = root.openNextFile();
-            while (file) {
-                debug(("Found in root: " + std::string(file.name())).c_str());
-                file = root.openNextFile();
-            }
-        }
+        defaultStorage.list("/", [this](const std::string& path, const SPAstorage::Stat&) {
+            debug(("Found in root: " + path).c_str());
+        });
     } else {
         debug(("System directory exists: " + sysPath).c_str());
+        for (const char* name : systemFiles) {
+            if (!fileExists(sysPath + "/" + name)) {
+                error(("System file does not exist: " + sysPath + "/" + name).c_str());
+            }
+        }
     }
+    bootTimings.checkUs = micros() - phaseStart;
 
     // Serve each system file individually
-    std::string cssFilePath = sysPath + "/SPAmanager.css";
-    std::string htmlFilePath = sysPath + "/SPAmanager.html";
-    std::string jsFilePath = sysPath + "/SPAmanager.js";
-    std::string disconnectedFilePath = sysPath + "/disconnected.html";
-
-    // Debug each file path
-    debug(("CSS file path: [" + cssFilePath + "]").c_str());
-    debug(("HTML file path: [" + htmlFilePath + "]").c_str());
-    debug(("JS file path: [" + jsFilePath + "]").c_str());
-    debug(("Disconnected file path: [" + disconnectedFilePath + "]").c_str());
-    
-    // Check if each file exists
-    if (!LittleFS.exists(cssFilePath.c_str())) {
-        error(("CSS file does not exist: " + cssFilePath).c_str());
-    }
-    if (!LittleFS.exists(htmlFilePath.c_str())) {
-        error(("HTML file does not exist: " + htmlFilePath).c_str());
-    }
-    if (!LittleFS.exists(jsFilePath.c_str())) {
-        error(("JS file does not exist: " + jsFilePath).c_str());
-    }
-    if (!LittleFS.exists(disconnectedFilePath.c_str())) {
-        error(("Disconnected file does not exist: " + disconnectedFilePath).c_str());
+    phaseStart = micros();
+    for (const char* name : systemFiles) {
+        serveAsset(std::string("/") + name, sysPath + "/" + name);
     }
 
-    // Serve the system files
-    server.serveStatic("/SPAmanager.html", LittleFS, htmlFilePath.c_str());
-    debug(("server.serveStatic(/SPAmanager.html, LittleFS, " + htmlFilePath + ")").c_str());
+    server.on("/spa-bundle.js", HTTP_GET, [this]() {
+        sendBundle(".js");
+    });
+    server.on("/spa-bundle.css", HTTP_GET, [this]() {
+        sendBundle(".css");
+    });
 
-    server.serveStatic("/SPAmanager.css", LittleFS, cssFilePath.c_str());
-    debug(("server.serveStatic(/SPAmanager.css, LittleFS, " + cssFilePath + ")").c_str());
-    
-    server.serveStatic("/SPAmanager.js", LittleFS, jsFilePath.c_str());
-    debug(("server.serveStatic(/SPAmanager.js, LittleFS, " + jsFilePath + ")").c_str());
-    
-    server.serveStatic("/disconnected.html", LittleFS, disconnectedFilePath.c_str());
-    debug(("server.serveStatic(/disconnected.html, LittleFS, " + disconnectedFilePath + ")").c_str());
+    // Optional service worker that keeps the app shell in the browser
+    std::string serviceWorkerPath = sysPath + "/SPAserviceWorker.js";
+    server.on("/spa-sw.js", HTTP_GET, [this, serviceWorkerPath]() {
+        if (!serviceWorkerEnabled) {
+            server.send(404, "text/plain", "Not found");
+            return;
+        }
+        sendAsset(serviceWorkerPath);
+    });
+    server.on("/spa-assets.json", HTTP_GET, [this]() {
+        if (!serviceWorkerEnabled) {
+            server.send(404, "text/plain", "Not found");
+            return;
+        }
+        sendShellManifest();
+    });
 
     server.on("/", HTTP_GET, [this]() {
+        if (bootTimings.firstRequestAtMs == 0) {
+            bootTimings.firstRequestAtMs = millis();
+        }
+        if (firstPageRendering && sendRenderedShell()) {
+            return;
+        }
         server.sendHeader("Location", "/SPAmanager.html", true);
         server.send(302, "text/plain", "");
     });
+    bootTimings.routesUs += micros() - phaseStart;
+
+    // Needed to choose between a file and its gzipped sibling
+    static const char* assetHeaders[] = { "Accept-Encoding", "If-None-Match" };
+    server.collectHeaders(assetHeaders, sizeof(assetHeaders) / sizeof(assetHeaders[0]));
+
+    phaseStart = micros();
     server.begin();
+    bootTimings.serverStartUs = micros() - phaseStart;
 
   } // setupWebServer()
 
@@ -195,9 +219,18 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
             delay(100);
         }
         
+        if (bootTimings.firstClientAtMs == 0) {
+            bootTimings.firstClientAtMs = millis();
+        }
+        
         // Store new client info
         currentClient = num;
         hasConnectedClient = true;
+        clearOutbound();
+        clientFlows[num] = ClientFlow();
+        // The url the client connected to, "/?gzip=1" when it can decompress pages
+        clientFlows[num].acceptsGzip = payload && strstr((const char*)payload, "gzip=1") != nullptr;
+        updatePageLifecycle();
         
         // Set the page title for the new client
         if (activePage)
@@ -210,11 +243,13 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
     }
     else if (type == WStype_DISCONNECTED)
     {
+        clientFlows.erase(num);
         // Only clear connection if it's our current client
         if (num == currentClient)
         {
             hasConnectedClient = false;
             debug("Current client disconnected");
+            updatePageLifecycle();
         }
         eventHandled = true;
     }
@@ -227,6 +262,18 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
         }
 
         payload[length] = 0;
+
+        // Flow control acks are frequent, keep them away from the full message handling
+        if (strncmp((const char*)payload, "{\"type\":\"ack\"", 13) == 0)
+        {
+            DynamicJsonDocument ackDoc(JSON_OBJECT_SIZE(2) + 32);
+            if (!deserializeJson(ackDoc, (const char*)payload, length))
+            {
+                handleClientAck(num, ackDoc["frames"] | 0);
+            }
+            return;
+        }
+
         std::string message = std::string((char*)payload);
         //const size_t capacity = JSON_OBJECT_SIZE(10) + 256;
         const size_t capacity = 5000; // Adjusted for larger messages
@@ -247,10 +294,20 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
         }
 
         if (doc["type"] == "menuClick") {
-            const char* menuName = doc["menu"];
-            const char* itemName = doc["item"];
+            const char* menuName = doc["menu"] | "";
+            const char* itemName = doc["item"] | "";
             
-            if (activePage) {
+            if (activePage && doc["id"].is<unsigned int>()) {
+                // The id the item got when it was added, no names to compare
+                unsigned int itemId = doc["id"];
+                if (itemId < menuItemTable.size()) {
+                    const Menu& menu = menus[menuItemTable[itemId].menu];
+                    const MenuItem& item = menu.items[menuItemTable[itemId].item];
+                    if (strcmp(menu.pageName, activePage->name) == 0 && item.callback && !item.disabled) {
+                        item.callback();
+                    }
+                }
+            } else if (activePage) {
                 for (const auto& menu : menus) 
                 {
                     if (strcmp(menu.name, menuName) == 0 && strcmp(menu.pageName, activePage->name) == 0) 
@@ -276,64 +333,21 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
             
             if (activePage) 
             {
-                for (auto& page : pages) {
-                    if (strcmp(page.name, activePage->name) == 0) {
-                        if (!page.isFileStorage) {
-                            debug("Page is not using file storage, skipping input change");
-                            return;
-                        }
-                        
-                        // Read the current content from file
-                        std::string content = getPageContent(page);
-                        if (content.empty() || content == DEFAULT_ERROR_PAGE) {
-                            debug("Failed to read page content or using error page");
-                            return;
-                        }
-                        
-                        std::string idStr1 = std::string("id='") + placeholder + "'";
-                        std::string idStr2 = std::string("id=\"") + placeholder + "\"";
-                        size_t pos = content.find(idStr1);
-                        if (pos == std::string::npos) {
-                            pos = content.find(idStr2);
-                        }
-                        
-                        if (pos != std::string::npos) {
-                            size_t inputStart = content.rfind("<input", pos);
-                            if (inputStart != std::string::npos && inputStart < pos) {
-                                // Find value attribute or closing bracket
-                                size_t valueStart1 = content.find("value='", inputStart);
-                                size_t valueStart2 = content.find("value=\"", inputStart);
-                                size_t closingBracket = content.find(">", inputStart);
-                                
-                                if (valueStart1 != std::string::npos && valueStart1 < closingBracket) {
-                                    // Value attribute exists with single quotes
-                                    size_t valueEnd = content.find("'", valueStart1 + 7);
-                                    if (valueEnd != std::string::npos) {
-                                        content.replace(valueStart1 + 7, valueEnd - (valueStart1 + 7), value);
-                                    }
-                                } else if (valueStart2 != std::string::npos && valueStart2 < closingBracket) {
-                                    // Value attribute exists with double quotes
-                                    size_t valueEnd = content.find("\"", valueStart2 + 7);
-                                    if (valueEnd != std::string::npos) {
-                                        content.replace(valueStart2 + 7, valueEnd - (valueStart2 + 7), value);
-                                    }
-                                } else {
-                                    // No value attribute, insert before closing bracket
-                                    content.insert(closingBracket, " value=\"" + std::string(value) + "\"");
-                                }
-                                
-                                // Write the updated content back to the file
-                                File pageFile = LittleFS.open(page.filePath, "w");
-                                if (pageFile) {
-                                    pageFile.print(content.c_str());
-                                    pageFile.close();
-                                } else {
-                                    this->error(("Failed to open page file for writing: " + std::string(page.filePath)).c_str());
-                                }
-                            }
-                        }
-                        break;
-                    }
+                if (!activePage->hasContent()) {
+                    debug("Page is not using file storage, skipping input change");
+                    return;
+                }
+                
+                ElementLocation element;
+                if (valueStore.isOpen()) {
+                    // The local event callback below still gets the input
+                    valueStore.set(valueKey(activePage->name, placeholder), value);
+                } else if (locateElement(*activePage, placeholder, element, false) 
+                        && element.tag.compare(0, 6, "<input") == 0) {
+                    std::string tag = element.tag;
+                    setTagAttribute(tag, "value", value);
+                    // Write the updated content back to the file
+                    patchElement(*activePage, element, tag, nullptr);
                 }
             }
             eventHandled = true;
@@ -341,65 +355,62 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
         else if (doc["type"] == "pageLoaded") 
         {
           debug("WebSocket: pageLoaded message received");
+          // The pages the browser kept from earlier visits
+          JsonObject cachedPages = doc["pageDigests"];
+          for (JsonPair cachedPage : cachedPages) 
+          {
+            const char* digest = cachedPage.value() | "";
+            clientFlows[num].pageDigests[cachedPage.key().c_str()] = strtoul(digest, nullptr, 16);
+          }
+          JsonObject cachedPopups = doc["popupDigests"];
+          for (JsonPair cachedPopup : cachedPopups) 
+          {
+            clientFlows[num].popupDigests[cachedPopup.key().c_str()] = cachedPopup.value() | "";
+          }
+          // Before the page, so its frames already go the configured way
+          sendClientOptions();
           if (!firstPageName.empty()) 
           {
             debug(("Activating first page: [" + firstPageName + "]").c_str());
             activatePage(firstPageName.c_str());
           }
           
-          // Include all scripts in servedFiles
-          debug("Including all files in servedFiles");
-          for (const auto& scriptPath : servedFiles) 
-          {
-            debug(("pageLoaded:: Including file: [" + scriptPath + "]").c_str());
-            
-            // Extract the script file name from the full path
-            std::string sanitizedJsFile;
-            size_t pos = scriptPath.find(rootSystemPath);
-            if (pos != std::string::npos) 
-            {
-              // If rootSystemPath is found, remove it from the path
-              sanitizedJsFile = scriptPath.substr(pos + rootSystemPath.length());
-            } else {
-              // If rootSystemPath is not found, just use the scriptPath itself
-              sanitizedJsFile = scriptPath;
-            }
-            
-            // Ensure the file path starts with a '/'
-            if (!sanitizedJsFile.empty() && sanitizedJsFile[0] != '/') 
-            {
-              sanitizedJsFile = "/" + sanitizedJsFile;
-            }
-          
-            debug(("Including file: [" + sanitizedJsFile + "]").c_str());
-          
-            const size_t capacity = JSON_OBJECT_SIZE(2);
-            DynamicJsonDocument scriptDoc(capacity);
-          
-            // Determine if this is a CSS file or JS file based on extension
-            if (sanitizedJsFile.find(".css") != std::string::npos) 
-            {
-              scriptDoc["event"] = "includeCssFile";
-            } else {
-              scriptDoc["event"] = "includeJsFile";
-            }
-            scriptDoc["data"] = sanitizedJsFile.c_str();
-          
-            std::string output;
-            serializeJson(scriptDoc, output);
+          // Announce all included files in one frame, the client fetches them in parallel
+          sendAssetManifest();
           
-            if (!output.empty()) 
-            {
-              debug(("Broadcasting include message: [" + output + "]").c_str());
-              ws.broadcastTXT(output.c_str(), output.length());
-            }
-          }
           if (pageLoadedCallback) 
           {
             pageLoadedCallback();
           }
           eventHandled = true;
         }
+        else if (doc["type"] == "popupCacheMiss") 
+        {
+          // The browser does not have the popup it was asked to open, send it with its content
+          const char* popupId = doc["id"] | "";
+          debug(("WebSocket: popupCacheMiss for [" + std::string(popupId) + "]").c_str());
+          clientFlows[num].popupDigests.erase(popupId);
+          std::map<std::string, std::string> values;
+          JsonObject valueObj = doc["values"];
+          for (JsonPair value : valueObj) 
+          {
+            values[value.key().c_str()] = value.value() | "";
+          }
+          openPopup(popupId, values);
+          eventHandled = true;
+        }
+        else if (doc["type"] == "pageCacheMiss") 
+        {
+          // The browser dropped the page it told us about, send it in full
+          const char* pageName = doc["page"] | "";
+          debug(("WebSocket: pageCacheMiss for [" + std::string(pageName) + "]").c_str());
+          clientFlows[num].pageDigests.erase(pageName);
+          if (activePage && strcmp(activePage->name, pageName) == 0) 
+          {
+            streamPageContent(*activePage);
+          }
+          eventHandled = true;
+        }
         else if (doc["type"] == "jsFunctionResult") 
         {
           const char* functionName = doc["functionName"];
@@ -457,33 +468,27 @@ void SPAmanager::handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t * payl
           
           // Check if this is a popup-related process type
           bool isPopupHandled = false;
-          if (strlen(popupId) > 0) {
-            // This might be a popup-related process type, check if the popupId matches any of our registered popups
-            for (const auto& menu : menus) {
-              for (const auto& item : menu.items) {
-                // Check if this item's callback is a popup callback
-                std::string itemPopupId = std::string("popup_") + menu.name + "_" + item.name;
-                // Replace spaces with underscores
-                for (size_t i = 0; i < itemPopupId.length(); i++) {
-                  if (itemPopupId[i] == ' ') {
-                    itemPopupId[i] = '_';
-                  }
-                }
-                
-                if (itemPopupId == popupId) {
-                  // This is the menu item that created the popup
-                  // Call its popup callback if it exists
-                  if (item.popupCallback) {
-                    debug(("Calling popup callback for: " + itemPopupId).c_str());
-                    item.popupCallback(inputValues);
-                    isPopupHandled = true;
-                  } else {
-                    debug(("No popup callback found for: " + itemPopupId).c_str());
-                  }
-                  break;
-                }
-              }
-              if (isPopupHandled) break;
+          PopupTemplate* popup = nullptr;
+          if (doc["popupKey"].is<unsigned int>()) {
+            // The id the popup got when it was registered
+            unsigned int popupKey = doc["popupKey"];
+            if (popupKey < popupTable.size()) {
+              popup = popupTable[popupKey];
+            }
+          } else if (strlen(popupId) > 0) {
+            auto found = popupTemplates.find(popupId);
+            if (found != popupTemplates.end()) {
+              popup = &found->second;
+            }
+          }
+          if (popup) {
+            // Call its popup callback if it exists
+            if (popup->callback) {
+              debug(("Calling popup callback for: " + std::string(popupId)).c_str());
+              popup->callback(inputValues);
+              isPopupHandled = true;
+            } else {
+              debug(("No popup callback found for: " + std::string(popupId)).c_str());
             }
           }
           
@@ -542,7 +547,7 @@ void SPAmanager::broadcastState()
     // Create a JSON document without the page content
     const size_t capacity = JSON_ARRAY_SIZE(5) +
                            JSON_ARRAY_SIZE(10) +
-                           10 * JSON_OBJECT_SIZE(3) +
+                           10 * JSON_OBJECT_SIZE(4) +
                            JSON_OBJECT_SIZE(10) +
                            256; // Reduced size since we're not including page content
                            
@@ -555,7 +560,7 @@ void SPAmanager::broadcastState()
     // Set metadata but not the content
     doc["pageName"] = activePage ? activePage->name : "";
     doc["isVisible"] = activePage ? true : false;
-    doc["hasContent"] = activePage && activePage->isFileStorage;
+    doc["hasContent"] = activePage && activePage->hasContent();
     
     // Other state information
     doc["message"] = currentMessage;
@@ -575,6 +580,7 @@ void SPAmanager::broadcastState()
             for (const auto& item : menu.items) {
                 JsonObject itemObj = itemArray.createNestedObject();
                 itemObj["name"] = item.name;
+                itemObj["id"] = item.id;
                 if (item.hasUrl()) {
                     itemObj["url"] = item.url;
                 }
@@ -587,24 +593,23 @@ void SPAmanager::broadcastState()
     serializeJson(doc, output);
     
     if (!output.empty()) {
-        ws.broadcastTXT(output.c_str(), output.length());
+        queueFrame(LANE_CONTROL, output, "state");
         
         // If there's an active page with content, stream it separately
-        if (activePage && activePage->isFileStorage) {
+        if (activePage && activePage->hasContent()) {
             streamPageContent(*activePage);
+            // The streamed page holds stale values for bound variables, resend them
+            handleBindings(true);
+            sendStoredValues();
+            // Providers are evaluated again on the next loop() and their values resent
+            for (auto& bound : providers) {
+                bound.wasActive = false;
+            }
         } else if (activePage) {
             // Send error page if there's no file storage
-            const size_t errorCapacity = JSON_OBJECT_SIZE(3) + strlen(DEFAULT_ERROR_PAGE) + 50;
-            DynamicJsonDocument errorDoc(errorCapacity);
-            errorDoc["type"] = "pageContent";
-            errorDoc["content"] = DEFAULT_ERROR_PAGE;
-            
-            std::string errorOutput;
-            serializeJson(errorDoc, errorOutput);
-            
-            if (!errorOutput.empty()) {
-                ws.broadcastTXT(errorOutput.c_str(), errorOutput.length());
-            }
+            flowStats.framesDropped += outboundQueue[LANE_BULK].size();
+            outboundQueue[LANE_BULK].clear();
+            queueErrorPage();
         }
     } else {
         debug("Failed to serialize JSON for broadcast state");
@@ -613,8 +618,71 @@ void SPAmanager::broadcastState()
 
 
 // method to stream page content in chunks
+// The chunks are not sent here: the bulk lane reads and sends them one
+// at a time from loop(), so control frames are never stuck behind a page.
 void SPAmanager::streamPageContent(const Page& page) 
 {
+    const size_t chunkSize = 1024;
+
+    // A new page supersedes whatever bulk data was still waiting
+    if (pageStream.active) {
+        flowStats.framesDropped += pageStream.totalChunks - pageStream.chunkIndex;
+        pageStream.active = false;
+    }
+    flowStats.framesDropped += outboundQueue[LANE_BULK].size();
+    outboundQueue[LANE_BULK].clear();
+
+    // The client still has this version of the page, one small frame is enough
+    uint32_t digest = pageDigest(page);
+    auto flow = clientFlows.find(currentClient);
+    if (digest != 0 && flow != clientFlows.end()) {
+        auto held = flow->second.pageDigests.find(page.name);
+        if (held != flow->second.pageDigests.end() && held->second == digest) {
+            debug(("streamPageContent(): client has [" + std::string(page.name) + "] cached").c_str());
+            DynamicJsonDocument cachedDoc(JSON_OBJECT_SIZE(3) + MAX_NAME_LEN + 40);
+            cachedDoc["type"] = "pageCached";
+            cachedDoc["page"] = page.name;
+            cachedDoc["digest"] = digestHex(digest);
+            std::string cachedOutput;
+            serializeJson(cachedDoc, cachedOutput);
+            queueFrame(LANE_BULK, cachedOutput);
+            return;
+        }
+    }
+
+    pageStream.pageName = page.name;
+    pageStream.digest = digest;
+    pageStream.chunkIndex = 0;
+    pageStream.offset = 0;
+    pageStream.queuedAt = millis();
+    pageStream.gzip = false;
+    pageStream.headerSent = false;
+    pageStream.cached.reset();
+
+    // A compiled page that is not modified yet can go out gzipped
+    if (page.staticContent && page.staticGzip && flow != clientFlows.end() && flow->second.acceptsGzip) {
+        debug(("streamPageContent(): Streaming gzipped page: " + pageStream.pageName).c_str());
+        pageStream.memory = (const char*)page.staticGzip;
+        pageStream.filePath.clear();
+        pageStream.fileSize = page.staticGzipSize;
+        pageStream.gzip = true;
+        pageStream.totalChunks = (pageStream.fileSize + chunkSize - 2) / (chunkSize - 1); // Ceiling division
+        pageStream.active = pageStream.fileSize > 0;
+        return;
+    }
+
+    // Static pages are read straight from the string they were registered with
+    if (page.staticContent) {
+        debug(("streamPageContent(): Streaming static page: " + pageStream.pageName).c_str());
+        pageStream.memory = page.staticContent;
+        pageStream.filePath.clear();
+        pageStream.fileSize = page.staticLength();
+        pageStream.totalChunks = (pageStream.fileSize + chunkSize - 2) / (chunkSize - 1); // Ceiling division
+        pageStream.active = pageStream.fileSize > 0;
+        return;
+    }
+    pageStream.memory = nullptr;
+
     //-- Remove leading slash for LittleFS
     std::string filePath = page.filePath;
     if (!filePath.empty() && filePath[0] != '/') {
@@ -625,265 +693,1833 @@ void SPAmanager::streamPageContent(const Page& page)
         filePath.pop_back();
     }
 
-    debug(("streamPageContent(): Streaming page content from file: " + filePath).c_str());
-    File pageFile = LittleFS.open(filePath.c_str(), "r");
-    if (!pageFile) {
+    SPAstorage::Stat info = getFileInfo(filePath);
+    if (!info.exists || info.isDirectory) {
         error(("Failed to open page file: " + filePath).c_str());
-        
-        // Send error page
-        const size_t errorCapacity = JSON_OBJECT_SIZE(3) + strlen(DEFAULT_ERROR_PAGE) + 50;
-        DynamicJsonDocument errorDoc(errorCapacity);
-        errorDoc["type"] = "pageContent";
-        errorDoc["content"] = DEFAULT_ERROR_PAGE;
-        
-        std::string errorOutput;
-        serializeJson(errorDoc, errorOutput);
-        
-        if (!errorOutput.empty()) {
-            ws.broadcastTXT(errorOutput.c_str(), errorOutput.length());
-        }
+        queueErrorPage();
         return;
     }
-    
-    // Stream content in chunks
-    const size_t chunkSize = 1024;
-    char buffer[chunkSize];
-    int chunkIndex = 0;
-    int totalChunks = (pageFile.size() + chunkSize - 1) / chunkSize; // Ceiling division
-    
-    while (pageFile.available()) {
-        size_t bytesRead = pageFile.readBytes(buffer, chunkSize - 1);
-        buffer[bytesRead] = '\0';
-        
-        // Create a JSON document for this chunk
-        const size_t chunkCapacity = JSON_OBJECT_SIZE(5) + bytesRead + 50;
-        DynamicJsonDocument chunkDoc(chunkCapacity);
-        chunkDoc["type"] = "pageChunk";
-        chunkDoc["content"] = buffer;
-        chunkDoc["chunkIndex"] = chunkIndex;
-        chunkDoc["totalChunks"] = totalChunks;
-        chunkDoc["final"] = !pageFile.available();
-        
-        std::string chunkOutput;
-        serializeJson(chunkDoc, chunkOutput);
-        
-        if (!chunkOutput.empty()) {
-            ws.broadcastTXT(chunkOutput.c_str(), chunkOutput.length());
-        }
-        
-        chunkIndex++;
-        yield(); // Allow other tasks to run
+    debug(("streamPageContent(): Streaming page content from file: " + filePath).c_str());
+    pageStream.filePath = filePath;
+    pageStream.fileSize = info.size;
+    // A hot page is read from RAM
+    pageStream.cached = cachedFile(*storage, filePath, info.size);
+    if (pageStream.cached) {
+        pageStream.memory = pageStream.cached->data;
     }
-    
-    pageFile.close();
+    pageStream.totalChunks = (pageStream.fileSize + chunkSize - 2) / (chunkSize - 1); // Ceiling division
+    pageStream.active = true;
+
 } // streamPageContent()
 
 
-// ensure the pages directory exists
-bool SPAmanager::ensurePageDirectory() 
+// read and send the next chunk of the page being streamed
+bool SPAmanager::sendNextPageChunk()
 {
-    std::string pagesDir = PAGES_DIRECTORY;
-    if (pagesDir[0] != '/') {
-        pagesDir = "/"+pagesDir; // Add leading slash for LittleFS
+    if (!pageStream.active) {
+        return false;
     }
-    // Remove trailing slash if present (but not if it's just "/")
-    if (pagesDir.length() > 1 && pagesDir.back() == '/') {
-        pagesDir.pop_back();
+    if (!hasConnectedClient || pageStream.offset >= pageStream.fileSize) {
+        pageStream.active = false;
+        return false;
     }
-    if (!LittleFS.exists(pagesDir.c_str())) {
-        debug(("ensurePageDirectory(): Creating [" + pagesDir + "] directory").c_str());
-        if (!LittleFS.mkdir(pagesDir.c_str())) {
-            error(("ensurePageDirectory(): Failed to create [" + pagesDir + "] directory").c_str());
-            return false;
+
+    const size_t chunkSize = 1024;
+    
+    // The client has to know how many bytes to collect before it can decompress them
+    if (pageStream.gzip && !pageStream.headerSent) {
+        DynamicJsonDocument headerDoc(JSON_OBJECT_SIZE(5) + MAX_NAME_LEN + 70);
+        headerDoc["type"] = "pageGzip";
+        headerDoc["size"] = pageStream.fileSize;
+        headerDoc["totalChunks"] = pageStream.totalChunks;
+        headerDoc["page"] = pageStream.pageName;
+        headerDoc["digest"] = digestHex(pageStream.digest);
+        std::string headerOutput;
+        serializeJson(headerDoc, headerOutput);
+        sendFrame(LANE_BULK, headerOutput, pageStream.queuedAt);
+        pageStream.headerSent = true;
+        return true;
+    }
+    
+    char buffer[chunkSize];
+    size_t bytesRead;
+    if (pageStream.memory) {
+        bytesRead = std::min(chunkSize - 1, pageStream.fileSize - pageStream.offset);
+        memcpy(buffer, pageStream.memory + pageStream.offset, bytesRead);
+    } else {
+        bytesRead = storage->read(pageStream.filePath, pageStream.offset, buffer, chunkSize - 1);
+    }
+    buffer[bytesRead] = '\0';
+    pageStream.offset += bytesRead;
+    bool isFinal = (bytesRead == 0 || pageStream.offset >= pageStream.fileSize);
+    
+    if (pageStream.gzip) {
+        sendFrame(LANE_BULK, std::string(buffer, bytesRead), pageStream.queuedAt, true);
+        pageStream.chunkIndex++;
+        if (isFinal) {
+            pageStreamDone();
         }
+        return true;
+    }
+    
+    // Create a JSON document for this chunk
+    const size_t chunkCapacity = JSON_OBJECT_SIZE(7) + bytesRead + MAX_NAME_LEN + 70;
+    DynamicJsonDocument chunkDoc(chunkCapacity);
+    chunkDoc["type"] = "pageChunk";
+    chunkDoc["content"] = buffer;
+    chunkDoc["chunkIndex"] = pageStream.chunkIndex;
+    chunkDoc["totalChunks"] = pageStream.totalChunks;
+    chunkDoc["final"] = isFinal;
+    if (pageStream.chunkIndex == 0) {
+        // Lets the client cache the page
+        chunkDoc["page"] = pageStream.pageName;
+        chunkDoc["digest"] = digestHex(pageStream.digest);
+    }
+    
+    std::string chunkOutput;
+    serializeJson(chunkDoc, chunkOutput);
+    
+    if (!chunkOutput.empty()) {
+        sendFrame(LANE_BULK, chunkOutput, pageStream.queuedAt);
+    }
+    pageStream.chunkIndex++;
+
+    if (isFinal) {
+        pageStreamDone();
     }
     return true;
 
-} //  ensurePageDirectory()
+} // sendNextPageChunk()
 
 
-// method to get page content from file
-std::string SPAmanager::getPageContent(const Page& page) 
+// the whole page went out, the client keeps it under its digest
+void SPAmanager::pageStreamDone()
 {
-    if (!page.isFileStorage) {
-        // For backward compatibility or error pages
-        return "";
+    pageStream.active = false;
+    pageStream.cached.reset();
+    auto flow = clientFlows.find(currentClient);
+    if (pageStream.digest != 0 && flow != clientFlows.end()) {
+        flow->second.pageDigests[pageStream.pageName] = pageStream.digest;
     }
-    
-    // Remove leading slash for LittleFS
-    std::string filePath = page.filePath;
-    if (!filePath.empty() && filePath[0] != '/') {
-        filePath = "/"+filePath;
+
+} // pageStreamDone()
+
+
+// the digest of the page content, read once after every change
+uint32_t SPAmanager::pageDigest(const Page& page)
+{
+    if (page.contentDigest != 0 || !page.hasContent()) {
+        return page.contentDigest;
     }
-    
-    debug(("Reading page content from file: " + filePath).c_str());
-    
-    // Check if file exists
-    if (!LittleFS.exists(filePath.c_str())) {
-        error(("Page file does not exist: " + filePath).c_str());
-        return DEFAULT_ERROR_PAGE;
+    PageSource source;
+    if (!openPageSource(page, source)) {
+        return 0;
     }
-    
-    File pageFile = LittleFS.open(filePath.c_str(), "r");
-    if (!pageFile) {
-        error(("Failed to open page file: " + filePath).c_str());
-        return DEFAULT_ERROR_PAGE;
+    char buffer[256];
+    size_t bytesRead;
+    uint32_t digest = 2166136261UL;
+    while ((bytesRead = source.read(buffer, sizeof(buffer))) > 0) {
+        digest = computeDigest(buffer, bytesRead, digest);
     }
-    
-    // Check file size
-    size_t fileSize = pageFile.size();
-    if (fileSize > MAX_CONTENT_LEN) {
-        error(("Page file too large: " + filePath + " (" + std::to_string(fileSize) + " bytes)").c_str());
-        pageFile.close();
-        return DEFAULT_ERROR_PAGE;
+    page.contentDigest = digest;
+    return digest;
+
+} // pageDigest()
+
+
+// restart the page stream if the page it is reading was rewritten
+void SPAmanager::pageContentChanged(const char* pageName)
+{
+    if (!pageStream.active || pageStream.pageName != pageName) {
+        return;
     }
+    debug(("pageContentChanged(): restarting stream of [" + pageStream.pageName + "]").c_str());
+    pageStream.active = false;
+    Page* page = findPage(pageName);
+    if (page) {
+        streamPageContent(*page);
+    }
+
+} // pageContentChanged()
+
+
+void SPAmanager::queueErrorPage()
+{
+    const size_t errorCapacity = JSON_OBJECT_SIZE(3) + strlen(DEFAULT_ERROR_PAGE) + 50;
+    DynamicJsonDocument errorDoc(errorCapacity);
+    errorDoc["type"] = "pageContent";
+    errorDoc["content"] = DEFAULT_ERROR_PAGE;
     
-    std::string content;
-    content.reserve(fileSize); // Pre-allocate memory
+    std::string errorOutput;
+    serializeJson(errorDoc, errorOutput);
     
-    while (pageFile.available()) {
-        // Read in chunks to avoid memory issues
-        char buffer[256];
-        size_t bytesRead = pageFile.readBytes(buffer, sizeof(buffer) - 1);
-        buffer[bytesRead] = '\0';
-        content += buffer;
+    if (!errorOutput.empty()) {
+        queueFrame(LANE_BULK, errorOutput);
     }
-    
-    pageFile.close();
-    return content;
 
-} // getPageContent()
+} // queueErrorPage()
 
 
-// write page content to file
-bool SPAmanager::writePageToFile(const char* pageName, const char* html) 
+// queue a frame for all clients; control frames go out at once unless the client is behind
+void SPAmanager::queueFrame(OutboundLane lane, const std::string& payload, const char* target)
 {
-    if (!ensurePageDirectory()) {
-        error("Failed to create pages directory");
-        return false;
+    if (!hasConnectedClient) {
+        return;  // Nobody to send it to
     }
-    
-    std::string filePath = PAGES_DIRECTORY;
-    filePath += pageName;
-    filePath += ".html";
-        
-    debug(("writePageToFile(): Writing page content to file: " + filePath).c_str());
-    
-    // Try to open the file
-    File pageFile = LittleFS.open(filePath.c_str(), "w");
-    if (!pageFile) {
-        error(("Failed to open page file for writing: " + filePath).c_str());
-        
-        // Try to ensure the directory exists again
-        if (ensurePageDirectory()) 
-        {
-            // Try opening the file again
-            pageFile = LittleFS.open(filePath.c_str(), "w");
-            if (!pageFile) {
-                error(("Still failed to open page file for writing: " + filePath).c_str());
-                return false;
+    std::deque<OutboundFrame>& queue = outboundQueue[lane];
+    if (lane == LANE_CONTROL && queue.empty() && !clientIsBehind()) {
+        sendFrame(lane, payload, millis());
+        return;
+    }
+
+    // A newer frame for the same target replaces the one still waiting
+    if (target && target[0] != '\0') {
+        for (auto& frame : queue) {
+            if (frame.target == target) {
+                frame.payload = payload;
+                flowStats.framesMerged++;
+                return;
             }
-        } else {
-            return false;
         }
     }
-    
-    // Write in chunks to avoid memory issues
-    const char* ptr = html;
-    const size_t chunkSize = 256;
-    bool writeSuccess = true;
-    
-    while (*ptr && writeSuccess) {
-        size_t bytesToWrite = 0;
-        while (bytesToWrite < chunkSize && ptr[bytesToWrite]) {
-            bytesToWrite++;
+
+    if (queue.size() >= MAX_QUEUED_FRAMES) {
+        // Only superseded updates may be discarded, and none could be merged:
+        // a client this far behind is dropped rather than silently missing frames.
+        // Not from here, queueFrame() runs inside the public API calls.
+        ClientFlow& flow = clientFlows[currentClient];
+        if (!flow.disconnectPending) {
+            error(("queueFrame(): queue of client [" + std::to_string(currentClient) + "] is full").c_str());
+            flow.disconnectPending = true;
         }
-        
-        if (bytesToWrite > 0) {
-            size_t bytesWritten = pageFile.write((uint8_t*)ptr, bytesToWrite);
-            if (bytesWritten != bytesToWrite) {
-                error("Failed to write complete chunk to file");
-                writeSuccess = false;
-            }
-            ptr += bytesToWrite;
+        if (flow.behindSince == 0) {
+            flow.behindSince = millis();
         }
+        return;
     }
-    
-    pageFile.close();
-    
-    // Verify the file was written correctly
-    if (writeSuccess) {
-        File verifyFile = LittleFS.open(filePath.c_str(), "r");
-        if (verifyFile) {
-            debug(("writePageToFile(): Successfully verified file: " + filePath).c_str());
-            verifyFile.close();
-        } else {
-            error(("Failed to verify file: " + filePath).c_str());
-            writeSuccess = false;
-        }
+
+    queue.push_back({payload, (uint32_t)millis(), target ? target : ""});
+    if (queue.size() > laneStats[lane].maxQueueDepth) {
+        laneStats[lane].maxQueueDepth = queue.size();
     }
-    
-    return writeSuccess;
 
-} //  writePageToFile()
+} // queueFrame()
 
 
-void SPAmanager::addPage(const char* pageName, const char* html) {
-    debug(("addPage() called with pageName: " + std::string(pageName)).c_str());
-    
-    // Store first page name if this is the first page
-    if (pages.empty()) {
-        firstPageName = pageName;
-    }
-    
-    // Check if page already exists
-    auto it = std::find_if(pages.begin(), pages.end(),
-        [pageName](const Page& page) { return strcmp(page.name, pageName) == 0; });
-    
-    if (it != pages.end()) {
-        // Page exists, update content
-        if (writePageToFile(pageName, html)) {
-            // Update file path if needed
-            std::string filePath = PAGES_DIRECTORY;
-            filePath += pageName;
-            filePath += ".html";
-            
-            // Ensure the path starts with a slash
-            if (filePath[0] != '/') {
-                filePath = "/" + filePath;
-            }
-            
-            it->setFilePath(filePath.c_str());
-            updateClients();
-        } else {
-            error(("Failed to update page file for: " + std::string(pageName)).c_str());
-        }
+void SPAmanager::sendFrame(OutboundLane lane, const std::string& payload, uint32_t queuedAt, bool binary)
+{
+    if (binary) {
+        ws.broadcastBIN((const uint8_t*)payload.data(), payload.length());
     } else {
-        // New page
-        if (writePageToFile(pageName, html)) {
-            Page page;
-            page.setName(pageName);
-            
-            std::string filePath = PAGES_DIRECTORY;
-            filePath += pageName;
-            filePath += ".html";
+        ws.broadcastTXT(payload.c_str(), payload.length());
+    }
+
+    ClientFlow& flow = clientFlows[currentClient];
+    flow.inFlight.push_back(payload.length());
+    flow.outstandingBytes += payload.length();
+    flow.framesSent++;
+
+    LaneStats& stats = laneStats[lane];
+    stats.framesSent++;
+    stats.lastLatencyMs = millis() - queuedAt;
+    if (stats.lastLatencyMs > stats.maxLatencyMs) {
+        stats.maxLatencyMs = stats.lastLatencyMs;
+    }
+
+} // sendFrame()
+
+
+// drain the lanes: everything in the control lane first, then one bulk frame
+void SPAmanager::processOutbound()
+{
+    if (!hasConnectedClient) {
+        return;
+    }
+    checkSlowClient();
+    if (!hasConnectedClient) {
+        return;
+    }
+
+    while (!outboundQueue[LANE_CONTROL].empty() && !clientIsBehind()) {
+        OutboundFrame frame = outboundQueue[LANE_CONTROL].front();
+        outboundQueue[LANE_CONTROL].pop_front();
+        sendFrame(LANE_CONTROL, frame.payload, frame.queuedAt);
+    }
+    if (!outboundQueue[LANE_CONTROL].empty() || clientIsBehind()) {
+        return;  // Bulk data waits until the client has caught up
+    }
+
+    if (!outboundQueue[LANE_BULK].empty()) {
+        OutboundFrame frame = outboundQueue[LANE_BULK].front();
+        outboundQueue[LANE_BULK].pop_front();
+        sendFrame(LANE_BULK, frame.payload, frame.queuedAt);
+    } else {
+        sendNextPageChunk();
+    }
+
+} // processOutbound()
+
+
+bool SPAmanager::clientIsBehind()
+{
+    auto it = clientFlows.find(currentClient);
+    if (it == clientFlows.end() || !it->second.ackSeen) {
+        return false;
+    }
+    return it->second.outstandingBytes > CLIENT_SEND_BUDGET;
+
+} // clientIsBehind()
+
+
+void SPAmanager::handleClientAck(uint8_t num, uint32_t framesReceived)
+{
+    ClientFlow& flow = clientFlows[num];
+    flow.ackSeen = true;
+    while (flow.framesAcked < framesReceived && !flow.inFlight.empty()) {
+        flow.outstandingBytes -= flow.inFlight.front();
+        flow.inFlight.pop_front();
+        flow.framesAcked++;
+    }
+
+} // handleClientAck()
+
+
+// disconnect a client that stays over its send budget for too long,
+// or whose queue overflowed since the last loop()
+void SPAmanager::checkSlowClient()
+{
+    ClientFlow& flow = clientFlows[currentClient];
+    if (flow.disconnectPending) {
+        disconnectSlowClient();
+        return;
+    }
+    if (!clientIsBehind()) {
+        flow.behindSince = 0;
+        return;
+    }
+    if (flow.behindSince == 0) {
+        flow.behindSince = millis();
+        debug(("Client [" + std::to_string(currentClient) + "] is behind: " + std::to_string(flow.outstandingBytes) + " bytes unacknowledged").c_str());
+        return;
+    }
+    if ((millis() - flow.behindSince) > SLOW_CLIENT_TIMEOUT) {
+        disconnectSlowClient();
+    }
+
+} // checkSlowClient()
+
+
+// the client reconnects and gets the whole state again
+void SPAmanager::disconnectSlowClient()
+{
+    error(("Client [" + std::to_string(currentClient) + "] stayed over its send budget, disconnecting").c_str());
+    flowStats.clientsDropped++;
+    clearOutbound();
+    ws.disconnect(currentClient);
+
+} // disconnectSlowClient()
+
+
+void SPAmanager::clearOutbound()
+{
+    for (size_t lane = 0; lane < LANE_COUNT; lane++) {
+        flowStats.framesDropped += outboundQueue[lane].size();
+        outboundQueue[lane].clear();
+    }
+    if (pageStream.active) {
+        flowStats.framesDropped += pageStream.totalChunks - pageStream.chunkIndex;
+        pageStream.active = false;
+    }
+
+} // clearOutbound()
+
+
+SPAmanager::FlowStats SPAmanager::getFlowStats() const
+{
+    FlowStats stats = flowStats;
+    auto it = clientFlows.find(currentClient);
+    stats.outstandingBytes = (hasConnectedClient && it != clientFlows.end()) ? it->second.outstandingBytes : 0;
+    return stats;
+
+} // getFlowStats()
+
+
+bool SPAmanager::useValueStore(SPAflashRegion& region)
+{
+    if (!valueStore.begin(region)) {
+        error("useValueStore(): no usable flash region for the value store");
+        return false;
+    }
+    const SPAvalueStore::Stats& stats = valueStore.getStats();
+    debug(("useValueStore(): " + std::to_string(stats.liveEntries) + " values replayed from " 
+            + std::to_string(stats.replayedRecords) + " records").c_str());
+    return true;
+
+} // useValueStore()
+
+
+#ifdef ESP32
+bool SPAmanager::useValueStore(const char* partitionLabel)
+{
+    if (!valuePartition.begin(partitionLabel)) {
+        error(("useValueStore(): partition [" + std::string(partitionLabel) + "] not found").c_str());
+        return false;
+    }
+    return useValueStore(valuePartition);
+
+} // useValueStore()
+#endif
+
+
+SPAvalueStore::Stats SPAmanager::getValueStoreStats() const
+{
+    return valueStore.getStats();
+
+} // getValueStoreStats()
+
+
+void SPAmanager::setAssetCacheBudget(size_t budgetBytes, size_t maxFileSize)
+{
+    debug(("setAssetCacheBudget(): " + std::to_string(budgetBytes) + " bytes" 
+            + (SPAassetCache::usesPsram() ? " in PSRAM" : "")).c_str());
+    assetCache.setBudget(budgetBytes, maxFileSize);
+
+} // setAssetCacheBudget()
+
+
+SPAassetCache::Stats SPAmanager::getAssetCacheStats() const
+{
+    return assetCache.getStats();
+
+} // getAssetCacheStats()
+
+
+std::string SPAmanager::valueKey(const char* pageName, const char* placeholder)
+{
+    return std::string(pageName) + "/" + placeholder;
+
+} // valueKey()
+
+
+// the page file does not hold values from the value store, send them after the page
+void SPAmanager::sendStoredValues()
+{
+    if (!valueStore.isOpen() || !activePage) {
+        return;
+    }
+    
+    std::vector<std::pair<std::string, std::string>> values;
+    std::string prefix = valueKey(activePage->name, "");
+    valueStore.forEach(prefix, [&values, &prefix](const std::string& key, const std::string& value) {
+        values.emplace_back(key.substr(prefix.length()), value);
+    });
+    if (values.empty()) {
+        return;
+    }
+    
+    size_t capacity = JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(values.size()) + values.size() * JSON_OBJECT_SIZE(2) + 64;
+    for (const auto& entry : values) {
+        capacity += entry.first.length() + entry.second.length() + 2;
+    }
+    DynamicJsonDocument doc(capacity);
+    if (doc.capacity() == 0) {
+        debug("Failed to allocate JSON buffer for stored values");
+        return;
+    }
+    doc["type"] = "updates";
+    JsonArray updateArray = doc.createNestedArray("updates");
+    for (const auto& entry : values) {
+        JsonObject updateObj = updateArray.createNestedObject();
+        updateObj["target"] = entry.first.c_str();
+        updateObj["content"] = entry.second.c_str();
+    }
+    
+    std::string output;
+    serializeJson(doc, output);
+    if (!output.empty()) {
+        queueFrame(LANE_CONTROL, output);
+    }
+
+} // sendStoredValues()
+
+
+SPAmanager::LaneStats SPAmanager::getLaneStats(OutboundLane lane) const
+{
+    LaneStats stats;
+    if (lane >= LANE_COUNT) {
+        return stats;
+    }
+    stats = laneStats[lane];
+    stats.queueDepth = outboundQueue[lane].size();
+    if (lane == LANE_BULK && pageStream.active) {
+        stats.queueDepth += pageStream.totalChunks - pageStream.chunkIndex;
+    }
+    return stats;
+
+} // getLaneStats()
+
+
+void SPAmanager::resetLaneStats()
+{
+    for (size_t lane = 0; lane < LANE_COUNT; lane++) {
+        laneStats[lane] = LaneStats();
+    }
+
+} // resetLaneStats()
+
+
+// ensure the pages directory exists
+bool SPAmanager::ensurePageDirectory() 
+{
+    std::string pagesDir = PAGES_DIRECTORY;
+    if (pagesDir[0] != '/') {
+        pagesDir = "/"+pagesDir; // Add leading slash for LittleFS
+    }
+    // Remove trailing slash if present (but not if it's just "/")
+    if (pagesDir.length() > 1 && pagesDir.back() == '/') {
+        pagesDir.pop_back();
+    }
+    if (!fileExists(pagesDir)) {
+        debug(("ensurePageDirectory(): Creating [" + pagesDir + "] directory").c_str());
+        if (!storage->mkdir(pagesDir)) {
+            error(("ensurePageDirectory(): Failed to create [" + pagesDir + "] directory").c_str());
+            return false;
+        }
+        // The new directory is empty, so it needs no walk
+        SPAstorage::Stat info;
+        info.exists = true;
+        info.isDirectory = true;
+        fileInfoCache[pagesDir] = info;
+        cachedDirectories.insert(pagesDir);
+    }
+    return true;
+
+} //  ensurePageDirectory()
+
+
+// open a page for sequential reading, from its file or its static string
+bool SPAmanager::openPageSource(const Page& page, PageSource& source)
+{
+    if (page.staticContent) {
+        source.memory = page.staticContent;
+        source.size = page.staticLength();
+        source.offset = 0;
+        return true;
+    }
+    if (!page.isFileStorage) {
+        return false;
+    }
+    
+    std::string filePath = page.filePath;
+    if (!filePath.empty() && filePath[0] != '/') {
+        filePath = "/"+filePath;
+    }
+    
+    SPAstorage::Stat info = getFileInfo(filePath);
+    if (!info.exists || info.isDirectory) {
+        error(("Failed to open page file: " + filePath).c_str());
+        return false;
+    }
+    source.storage = storage;
+    source.path = filePath;
+    source.memory = nullptr;
+    source.size = info.size;
+    source.offset = 0;
+    return true;
+
+} // openPageSource()
+
+
+// find the value of attribute [name] in a tag, returns npos if the tag does not have it
+size_t SPAmanager::findTagAttribute(const std::string& tag, const char* name, char& quote)
+{
+    std::string key = std::string(name) + "=";
+    size_t pos = tag.find(key);
+    while (pos != std::string::npos) {
+        size_t valueStart = pos + key.length();
+        // Skip matches like "data-id=" when looking for "id="
+        if (pos > 0 && isspace((unsigned char)tag[pos - 1]) 
+                    && valueStart < tag.length() 
+                    && (tag[valueStart] == '\'' || tag[valueStart] == '"')) {
+            quote = tag[valueStart];
+            return valueStart + 1;
+        }
+        pos = tag.find(key, pos + 1);
+    }
+    return std::string::npos;
+
+} // findTagAttribute()
+
+
+bool SPAmanager::getTagAttribute(const std::string& tag, const char* name, std::string& value)
+{
+    char quote;
+    size_t valueStart = findTagAttribute(tag, name, quote);
+    if (valueStart == std::string::npos) {
+        return false;
+    }
+    size_t valueEnd = tag.find(quote, valueStart);
+    if (valueEnd == std::string::npos) {
+        return false;
+    }
+    value = tag.substr(valueStart, valueEnd - valueStart);
+    return true;
+
+} // getTagAttribute()
+
+
+void SPAmanager::setTagAttribute(std::string& tag, const char* name, const std::string& value)
+{
+    char quote;
+    size_t valueStart = findTagAttribute(tag, name, quote);
+    if (valueStart != std::string::npos) {
+        size_t valueEnd = tag.find(quote, valueStart);
+        if (valueEnd != std::string::npos) {
+            tag.replace(valueStart, valueEnd - valueStart, value);
+            return;
+        }
+    }
+    // No such attribute, insert it before the closing bracket (or "/>")
+    size_t insertAt = tag.length() - 1;
+    if (insertAt > 0 && tag[insertAt - 1] == '/') {
+        insertAt--;
+    }
+    tag.insert(insertAt, " " + std::string(name) + "=\"" + value + "\"");
+
+} // setTagAttribute()
+
+
+// scan a page for the opening tag of the element with [id], using a fixed size buffer
+// so pages of any size can be searched
+bool SPAmanager::locateElement(const Page& page, const char* id, ElementLocation& element, bool withText)
+{
+    // A compiled page knows where its elements are
+    if (!page.elementIndex.empty()) {
+        for (const auto& indexed : page.elementIndex) {
+            if (strcmp(indexed.id, id) == 0) {
+                return readIndexedElement(page, indexed, element, withText);
+            }
+        }
+        debug(("locateElement(): no element with id [" + std::string(id) + "] in page [" + std::string(page.name) + "]").c_str());
+        return false;
+    }
+    
+    PageSource source;
+    if (!openPageSource(page, source)) {
+        return false;
+    }
+    
+    char buffer[256];
+    std::string tag;
+    tag.reserve(MAX_TAG_LEN);
+    bool inTag = false;
+    bool found = false;
+    bool done = false;
+    size_t tagStart = 0;
+    size_t offset = 0;
+    size_t bytesRead;
+    
+    while (!done && (bytesRead = source.read(buffer, sizeof(buffer))) > 0) {
+        for (size_t i = 0; i < bytesRead; i++) {
+            char c = buffer[i];
+            if (found) {
+                // Collect the element text up to the next tag
+                if (c == '<') {
+                    done = true;
+                    break;
+                }
+                if (element.text.length() < MAX_TAG_LEN) {
+                    element.text += c;
+                }
+                continue;
+            }
+            if (c == '<') {
+                inTag = true;
+                tagStart = offset + i;
+                tag.assign(1, c);
+                continue;
+            }
+            if (!inTag) {
+                continue;
+            }
+            if (tag.length() < MAX_TAG_LEN) {
+                tag += c;
+            }
+            if (c != '>') {
+                continue;
+            }
+            inTag = false;
+            
+            std::string tagId;
+            if (tag.back() == '>' && getTagAttribute(tag, "id", tagId) && tagId == id) {
+                found = true;
+                element.tagStart = tagStart;
+                element.tagEnd = offset + i;
+                element.tag = tag;
+                element.text.clear();
+                if (!withText) {
+                    done = true;
+                    break;
+                }
+            }
+        }
+        offset += bytesRead;
+    }
+    
+    if (!found) {
+        debug(("locateElement(): no element with id [" + std::string(id) + "] in page [" + std::string(page.name) + "]").c_str());
+    }
+    return found;
+
+} // locateElement()
+
+
+// read the opening tag (and text) of an element at the offsets from the page index
+bool SPAmanager::readIndexedElement(const Page& page, const IndexedElement& indexed, ElementLocation& element, bool withText)
+{
+    PageSource source;
+    if (!openPageSource(page, source)) {
+        return false;
+    }
+    if (indexed.textEnd > source.size || indexed.tagEnd >= indexed.textEnd) {
+        error(("Element index of page [" + std::string(page.name) + "] does not match the page").c_str());
+        return false;
+    }
+    
+    auto readRange = [&source](std::string& into, size_t from, size_t length) {
+        into.resize(length);
+        source.offset = from;
+        size_t done = 0;
+        size_t bytesRead;
+        while (done < length && (bytesRead = source.read(&into[done], length - done)) > 0) {
+            done += bytesRead;
+        }
+        return done == length;
+    };
+    
+    element.tagStart = indexed.tagStart;
+    element.tagEnd = indexed.tagEnd;
+    element.text.clear();
+    if (!readRange(element.tag, indexed.tagStart, indexed.tagEnd + 1 - indexed.tagStart)
+            || element.tag.front() != '<' || element.tag.back() != '>') {
+        error(("Element index of page [" + std::string(page.name) + "] does not match the page").c_str());
+        return false;
+    }
+    if (withText) {
+        size_t textLength = std::min(indexed.textEnd - indexed.tagEnd - 1, (size_t)MAX_TAG_LEN);
+        return readRange(element.text, indexed.tagEnd + 1, textLength);
+    }
+    return true;
+
+} // readIndexedElement()
+
+
+// move the offsets in the page index after patchElement() replaced a tag (and text)
+void SPAmanager::reindexElements(Page& page, const ElementLocation& element, size_t tagLength, const char* text)
+{
+    IndexedElement* patched = nullptr;
+    for (auto& indexed : page.elementIndex) {
+        if (indexed.tagStart == element.tagStart) {
+            patched = &indexed;
+            break;
+        }
+    }
+    if (!patched) {
+        return;
+    }
+    
+    size_t newTagEnd = patched->tagStart + tagLength - 1;
+    size_t newTextEnd = text ? newTagEnd + 1 + strlen(text) 
+                             : patched->textEnd - patched->tagEnd + newTagEnd;
+    long delta = (long)newTextEnd - (long)patched->textEnd;
+    patched->tagEnd = newTagEnd;
+    patched->textEnd = newTextEnd;
+    
+    for (auto& indexed : page.elementIndex) {
+        if (indexed.tagStart > element.tagStart) {
+            indexed.tagStart += delta;
+            indexed.tagEnd += delta;
+            indexed.textEnd += delta;
+        }
+    }
+
+} // reindexElements()
+
+
+// FNV-1a hash, used to recognise page content that is already on flash
+uint32_t SPAmanager::computeDigest(const char* data, size_t length, uint32_t digest)
+{
+    for (size_t i = 0; i < length; i++) {
+        digest ^= (uint8_t)data[i];
+        digest *= 16777619UL;
+    }
+    return digest;
+
+} // computeDigest()
+
+
+// load the page digest index (one small read, only once)
+void SPAmanager::loadPageDigests()
+{
+    if (pageDigestsLoaded) {
+        return;
+    }
+    pageDigestsLoaded = true;
+
+    std::string index = readWholeFile(*storage, PAGE_DIGESTS_FILE);
+    if (index.empty()) {
+        debug("loadPageDigests(): no page digest index yet");
+        return;
+    }
+    size_t lineStart = 0;
+    while (lineStart < index.length()) {
+        size_t lineEnd = index.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = index.length();
+        }
+        std::string line = index.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        size_t sep = line.rfind(' ');
+        if (sep == std::string::npos) {
+            continue;
+        }
+        pageDigests[line.substr(0, sep)] = strtoul(line.c_str() + sep + 1, nullptr, 16);
+    }
+    debug(("loadPageDigests(): " + std::to_string(pageDigests.size()) + " page digests loaded").c_str());
+
+} // loadPageDigests()
+
+
+bool SPAmanager::savePageDigests()
+{
+    std::string index;
+    for (const auto& entry : pageDigests) {
+        char digest[12];
+        snprintf(digest, sizeof(digest), " %08lx\n", (unsigned long)entry.second);
+        index += entry.first + digest;
+    }
+    return writeFileAtomic(PAGE_DIGESTS_FILE, index.c_str(), index.length());
+
+} // savePageDigests()
+
+
+// write a file via a temporary file and a rename, so a reset never leaves half a file
+bool SPAmanager::writeFileAtomic(const char* filePath, const char* data, size_t length)
+{
+    std::string tempPath = std::string(filePath) + ".tmp";
+
+    if (!storage->write(tempPath, data, length, false)) {
+        error(("Failed to write file: " + tempPath).c_str());
+        storage->remove(tempPath);
+        return false;
+    }
+    return replaceFile(tempPath, filePath, length);
+
+} // writeFileAtomic()
+
+
+// move a completely written temporary file over its destination
+bool SPAmanager::replaceFile(const std::string& tempPath, const char* filePath, size_t size)
+{
+    if (!storage->replace(tempPath, filePath)) {
+        error(("Failed to rename [" + tempPath + "] to [" + std::string(filePath) + "]").c_str());
+        storage->remove(tempPath);
+        // Whatever is left of the file now, the cache must not guess
+        std::string path = normalizePath(filePath);
+        if (isCachedPath(path)) {
+            storage->stat(path, fileInfoCache[path]);
+        }
+        return false;
+    }
+    fileWritten(filePath, size);
+    return true;
+
+} // replaceFile()
+
+
+std::string SPAmanager::normalizePath(const std::string& path)
+{
+    std::string normalized = path;
+    if (normalized.empty() || normalized[0] != '/') {
+        normalized = "/" + normalized;
+    }
+    if (normalized.length() > 1 && normalized.back() == '/') {
+        normalized.pop_back();
+    }
+    return normalized;
+
+} // normalizePath()
+
+
+// page files live in the page storage, everything else is served from LittleFS
+SPAstorage* SPAmanager::storageFor(const std::string& path)
+{
+    std::string pagesDir = normalizePath(PAGES_DIRECTORY);
+    if (path.compare(0, pagesDir.length(), pagesDir) == 0 
+            && (path.length() == pagesDir.length() || path[pagesDir.length()] == '/')) {
+        return storage;
+    }
+    return &defaultStorage;
+
+} // storageFor()
+
+
+// serve a file from LittleFS at [uri], like serveStatic() but preferring a ".gz" sibling
+void SPAmanager::serveAsset(const std::string& uri, const std::string& filePath)
+{
+    debug(("serveAsset(" + uri + ", " + filePath + ")").c_str());
+    server.on(uri.c_str(), HTTP_GET, [this, filePath]() {
+        sendAsset(filePath);
+    });
+
+} // serveAsset()
+
+
+void SPAmanager::sendAsset(const std::string& filePath)
+{
+    std::string sendPath = filePath;
+    String acceptEncoding = server.header("Accept-Encoding");
+    if (acceptEncoding.indexOf("gzip") >= 0 && fileExists(filePath + ".gz")) {
+        sendPath += ".gz";
+    }
+    
+    // The ETag is the digest of the content, the gzipped variant gets its own
+    std::string version = assetVersion(filePath);
+    std::string etag = "\"" + version + (sendPath == filePath ? "" : "-gz") + "\"";
+    // Caches must keep the plain and the gzipped response apart
+    server.sendHeader("Vary", "Accept-Encoding");
+    server.sendHeader("ETag", etag.c_str());
+    if (server.hasArg("v") && server.arg("v") == version.c_str()) {
+        // A url with the digest in it always has the same content
+        server.sendHeader("Cache-Control", "public, max-age=31536000, immutable");
+    } else {
+        server.sendHeader("Cache-Control", "no-cache");
+    }
+    time_t lastWrite = getFileInfo(sendPath).lastWrite;
+    if (lastWrite > 1577836800) {  // Not before 2020, so the clock was set when it was written
+        char httpDate[32];
+        strftime(httpDate, sizeof(httpDate), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&lastWrite));
+        server.sendHeader("Last-Modified", httpDate);
+    }
+    if (server.header("If-None-Match").indexOf(etag.c_str()) >= 0) {
+        server.send(304);
+        return;
+    }
+    
+    SPAassetCache::Entry cached = cachedFile(defaultStorage, sendPath, getFileInfo(sendPath).size);
+    if (cached) {
+        if (sendPath != filePath) {
+            server.sendHeader("Content-Encoding", "gzip");
+        }
+        server.send_P(200, contentTypeFor(filePath), cached->data, cached->size);
+        return;
+    }
+    
+    File file = LittleFS.open(sendPath.c_str(), "r");
+    if (!file) {
+        error(("sendAsset(): cannot open " + sendPath).c_str());
+        server.send(404, "text/plain", "Not found");
+        return;
+    }
+    // streamFile() adds "Content-Encoding: gzip" for a file that ends in ".gz"
+    server.streamFile(file, contentTypeFor(filePath));
+    file.close();
+
+} // sendAsset()
+
+
+// a file from the RAM cache, read into it on a miss when it is small enough
+SPAassetCache::Entry SPAmanager::cachedFile(SPAstorage& from, const std::string& filePath, size_t size)
+{
+    SPAassetCache::Entry cached = assetCache.get(filePath);
+    if (cached) {
+        return cached;
+    }
+    // put() counts a file that is too large as rejected
+    std::shared_ptr<SPAassetCache::Content> content = assetCache.put(filePath, size);
+    if (!content) {
+        return nullptr;
+    }
+    size_t offset = 0;
+    size_t bytesRead;
+    while (offset < size && (bytesRead = from.read(filePath, offset, content->data + offset, size - offset)) > 0) {
+        offset += bytesRead;
+    }
+    if (offset < size) {
+        error(("cachedFile(): could not read " + filePath).c_str());
+        assetCache.remove(filePath);
+        return nullptr;
+    }
+    return content;
+
+} // cachedFile()
+
+
+const char* SPAmanager::contentTypeFor(const std::string& path)
+{
+    static const struct { const char* extension; const char* contentType; } contentTypes[] = {
+        { ".html", "text/html" },
+        { ".css",  "text/css" },
+        { ".js",   "application/javascript" },
+        { ".json", "application/json" },
+        { ".svg",  "image/svg+xml" },
+        { ".png",  "image/png" },
+        { ".ico",  "image/x-icon" },
+    };
+    for (const auto& type : contentTypes) {
+        size_t length = strlen(type.extension);
+        if (path.length() >= length && path.compare(path.length() - length, length, type.extension) == 0) {
+            return type.contentType;
+        }
+    }
+    return "text/plain";
+
+} // contentTypeFor()
+
+
+// the digest of a file as 8 hex digits, from the asset manifest or read once
+std::string SPAmanager::assetVersion(const std::string& filePath)
+{
+    uint32_t digest;
+    auto asset = assetManifest.find(filePath);
+    auto known = assetDigests.find(filePath);
+    if (asset != assetManifest.end()) {
+        digest = asset->second.digest;
+    } else if (known != assetDigests.end()) {
+        digest = known->second;
+    } else {
+        char buffer[256];
+        size_t offset = 0;
+        size_t bytesRead;
+        digest = 2166136261UL;
+        while ((bytesRead = defaultStorage.read(filePath, offset, buffer, sizeof(buffer))) > 0) {
+            digest = computeDigest(buffer, bytesRead, digest);
+            offset += bytesRead;
+        }
+        assetDigests[filePath] = digest;
+    }
+    return digestHex(digest);
+
+} // assetVersion()
+
+
+std::string SPAmanager::digestHex(uint32_t digest)
+{
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%08lx", (unsigned long)digest);
+    return hex;
+
+} // digestHex()
+
+
+// the name the client knows an included file by: "/<file name>"
+std::string SPAmanager::assetName(const std::string& filePath)
+{
+    return "/" + filePath.substr(filePath.find_last_of('/') + 1);
+
+} // assetName()
+
+
+// send one frame with every included file, its versioned url and the files it depends on
+void SPAmanager::sendAssetManifest()
+{
+    if (servedFiles.empty() && !serviceWorkerEnabled) {
+        return;
+    }
+    size_t capacity = JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(2) + 96 + JSON_ARRAY_SIZE(servedOrder.size());
+    for (const auto& filePath : servedOrder) {
+        capacity += JSON_OBJECT_SIZE(3) + filePath.length() + 32;
+        auto deps = assetDependencies.find(filePath);
+        if (deps != assetDependencies.end()) {
+            capacity += JSON_ARRAY_SIZE(deps->second.size());
+            for (const auto& dep : deps->second) {
+                capacity += dep.length() + 1;
+            }
+        }
+    }
+    DynamicJsonDocument manifestDoc(capacity);
+    manifestDoc["event"] = "includeAssets";
+    JsonArray assets = manifestDoc.createNestedArray("assets");
+    for (const auto& filePath : servedOrder) {
+        JsonObject asset = assets.createNestedObject();
+        // The digest in the url lets the browser cache the file for good
+        asset["url"] = assetName(filePath) + "?v=" + assetVersion(filePath);
+        asset["type"] = (filePath.find(".css") != std::string::npos) ? "css" : "js";
+        auto deps = assetDependencies.find(filePath);
+        if (deps != assetDependencies.end() && !deps->second.empty()) {
+            JsonArray depArray = asset.createNestedArray("deps");
+            for (const auto& dep : deps->second) {
+                depArray.add(dep);
+            }
+        }
+    }
+    // Tell the client to install (or to remove) the service worker
+    if (serviceWorkerEnabled) {
+        manifestDoc["serviceWorker"] = "/spa-sw.js";
+    } else {
+        manifestDoc["serviceWorker"] = false;
+    }
+    // A client that has none of the files yet can fetch them in one request per type
+    JsonObject bundles = manifestDoc.createNestedObject("bundles");
+    for (const char* extension : { ".js", ".css" }) {
+        if (bundleFiles(extension).size() > 1) {
+            bundles[extension + 1] = "/spa-bundle" + std::string(extension) + "?v=" + bundleVersion(extension);
+        }
+    }
+    
+    std::string output;
+    serializeJson(manifestDoc, output);
+    debug(("sendAssetManifest(): [" + output + "]").c_str());
+    queueFrame(LANE_CONTROL, output);
+
+} // sendAssetManifest()
+
+
+// the files the service worker keeps: the shell, the included files and the bundles,
+// with a version that changes when any of them changes
+void SPAmanager::sendShellManifest()
+{
+    std::vector<std::string> urls;
+    uint32_t digest = 2166136261UL;
+    auto addUrl = [&urls, &digest](const std::string& url, const std::string& version) {
+        urls.push_back(url);
+        std::string entry = url + version;
+        digest = computeDigest(entry.c_str(), entry.length(), digest);
+    };
+    std::string sysPath = normalizePath(rootSystemPath);
+    for (const char* name : { "/SPAmanager.html", "/SPAmanager.css", "/SPAmanager.js", "/disconnected.html" }) {
+        addUrl(name, assetVersion(sysPath + name));
+    }
+    // The worker has to know whether "/" is the plain shell or a rendered page
+    digest = computeDigest(firstPageRendering ? "r" : "s", 1, digest);
+    for (const auto& filePath : servedOrder) {
+        std::string version = assetVersion(filePath);
+        addUrl(assetName(filePath) + "?v=" + version, version);
+    }
+    for (const char* extension : { ".js", ".css" }) {
+        if (bundleFiles(extension).size() > 1) {
+            std::string version = bundleVersion(extension);
+            addUrl("/spa-bundle" + std::string(extension) + "?v=" + version, version);
+        }
+    }
+
+    size_t capacity = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(urls.size()) + 16;
+    for (const auto& url : urls) {
+        capacity += url.length() + 1;
+    }
+    DynamicJsonDocument manifestDoc(capacity);
+    manifestDoc["version"] = digestHex(digest);
+    manifestDoc["rendersRoot"] = firstPageRendering;
+    JsonArray assets = manifestDoc.createNestedArray("assets");
+    for (const auto& url : urls) {
+        assets.add(url);
+    }
+    std::string output;
+    serializeJson(manifestDoc, output);
+    server.sendHeader("Cache-Control", "no-store");
+    server.send(200, "application/json", output.c_str());
+
+} // sendShellManifest()
+
+
+void SPAmanager::enableServiceWorker(bool enable)
+{
+    debug(("enableServiceWorker(" + std::string(enable ? "true" : "false") + ")").c_str());
+    serviceWorkerEnabled = enable;
+
+} // enableServiceWorker()
+
+
+void SPAmanager::enableFirstPageRendering(bool enable)
+{
+    debug(("enableFirstPageRendering(" + std::string(enable ? "true" : "false") + ")").c_str());
+    firstPageRendering = enable;
+
+} // enableFirstPageRendering()
+
+
+// the "</div>" that closes the div whose opening tag ends just before [from],
+// skipping the div pairs nested in it. npos when the divs do not balance.
+size_t SPAmanager::closingDivTag(const std::string& html, size_t from)
+{
+    int depth = 1;
+    size_t pos = from;
+    while ((pos = html.find("<", pos)) != std::string::npos) {
+        if (html.compare(pos, 6, "</div>") == 0) {
+            if (--depth == 0) {
+                return pos;
+            }
+        } else if (html.compare(pos, 4, "<div") == 0 && pos + 4 < html.length()
+                       && (isspace((unsigned char)html[pos + 4]) || html[pos + 4] == '>')) {
+            depth++;
+        }
+        pos++;
+    }
+    return std::string::npos;
+
+} // closingDivTag()
+
+
+// send SPAmanager.html with the menus, the active page and its current values already in it,
+// so the browser can paint the page before the WebSocket is open.
+// Returns false when there is nothing to render, the caller then redirects to the plain shell.
+// A shell that does not have the expected structure is sent as it is.
+bool SPAmanager::sendRenderedShell()
+{
+    if (!activePage || !activePage->hasContent()) {
+        return false;
+    }
+    std::string shellPath = normalizePath(rootSystemPath) + "/SPAmanager.html";
+    SPAstorage::Stat info = getFileInfo(shellPath);
+    if (!info.exists || info.isDirectory) {
+        return false;
+    }
+    std::string shell;
+    SPAassetCache::Entry cached = cachedFile(defaultStorage, shellPath, info.size);
+    if (cached) {
+        shell.assign(cached->data, cached->size);
+    } else {
+        shell = readWholeFile(defaultStorage, shellPath);
+    }
+    
+    // The page goes in place of whatever is inside <div id="bodyContent">,
+    // the menus in place of whatever is inside the first <div class="dM_left">
+    size_t bodyTag = shell.find("id=\"bodyContent\"");
+    size_t bodyTagStart = (bodyTag == std::string::npos) ? bodyTag : shell.rfind('<', bodyTag);
+    size_t bodyTagEnd = (bodyTag == std::string::npos) ? bodyTag : shell.find('>', bodyTag);
+    size_t bodyClose = (bodyTagEnd == std::string::npos) ? bodyTagEnd : closingDivTag(shell, bodyTagEnd + 1);
+    size_t menuTag = shell.find("class=\"dM_left\"");
+    size_t menuTagEnd = (menuTag == std::string::npos || menuTag > bodyTagStart) ? std::string::npos : shell.find('>', menuTag);
+    size_t menuClose = (menuTagEnd == std::string::npos) ? menuTagEnd : closingDivTag(shell, menuTagEnd + 1);
+    if (bodyTagStart == std::string::npos || bodyClose == std::string::npos 
+            || menuClose == std::string::npos || menuClose > bodyTagStart) {
+        error("sendRenderedShell(): SPAmanager.html has no bodyContent or dM_left element, sending it unrendered");
+        sendAsset(shellPath);
+        return true;
+    }
+    PageSource source;
+    if (!openPageSource(*activePage, source)) {
+        return false;
+    }
+    // Content-Length promises the whole page: check its size on the storage itself and
+    // read the first chunk, so a page that cannot be read still gets the plain shell
+    char buffer[1024];
+    SPAstorage::Stat pageInfo;
+    bool pageReadable = source.memory || (source.storage->stat(source.path, pageInfo) && pageInfo.size == source.size);
+    size_t bytesRead = pageReadable ? source.read(buffer, std::min(sizeof(buffer), source.size)) : 0;
+    if (!pageReadable || (source.size > 0 && bytesRead == 0)) {
+        error(("sendRenderedShell(): cannot read page [" + std::string(activePage->name) + "], sending the shell unrendered").c_str());
+        sendAsset(shellPath);
+        return true;
+    }
+    
+    // Tell the client which page this is, so it does not ask for it again
+    std::string bodyOpen = shell.substr(bodyTagStart, bodyTagEnd - bodyTagStart + 1);
+    setTagAttribute(bodyOpen, "style", "display: block;");
+    bodyOpen.insert(bodyOpen.length() - 1, " data-page=\"" + std::string(activePage->name) 
+                                           + "\" data-digest=\"" + digestHex(pageDigest(*activePage)) + "\"");
+    
+    std::string beforeMenu = shell.substr(0, menuTagEnd + 1);
+    std::string menuHTML = generateMenuHTML();
+    std::string beforeBody = shell.substr(menuClose, bodyTagStart - menuClose) + bodyOpen;
+    std::string afterBody = shell.substr(bodyClose, 6) + initialValuesScript() + shell.substr(bodyClose + 6);
+    
+    // The values in it are only current for this request
+    server.sendHeader("Cache-Control", "no-store");
+    server.setContentLength(beforeMenu.length() + menuHTML.length() + beforeBody.length() + source.size + afterBody.length());
+    server.send(200, "text/html", "");
+    server.sendContent(beforeMenu.c_str(), beforeMenu.length());
+    server.sendContent(menuHTML.c_str(), menuHTML.length());
+    server.sendContent(beforeBody.c_str(), beforeBody.length());
+    while (bytesRead > 0) {
+        server.sendContent(buffer, bytesRead);
+        bytesRead = source.read(buffer, std::min(sizeof(buffer), source.size - source.offset));
+    }
+    if (source.offset < source.size) {
+        // Short of Content-Length the browser fails the request at once instead of waiting
+        error(("sendRenderedShell(): page [" + std::string(activePage->name) + "] is shorter than expected, closing the connection").c_str());
+        server.client().stop();
+        return true;
+    }
+    server.sendContent(afterBody.c_str(), afterBody.length());
+    debug(("sendRenderedShell(): sent [" + std::string(activePage->name) + "]").c_str());
+    return true;
+
+} // sendRenderedShell()
+
+
+// an inline script that fills in the values that are not in the page file:
+// bound variables and values from the value store
+std::string SPAmanager::initialValuesScript()
+{
+    std::vector<std::pair<std::string, std::string>> values;
+    if (valueStore.isOpen()) {
+        std::string prefix = valueKey(activePage->name, "");
+        valueStore.forEach(prefix, [&values, &prefix](const std::string& key, const std::string& value) {
+            values.emplace_back(key.substr(prefix.length()), value);
+        });
+    }
+    for (auto& bound : bindings) {
+        if (strcmp(bound.pageName, activePage->name) == 0) {
+            values.emplace_back(bound.placeholder, bound.format());
+        }
+    }
+    for (const auto& bound : providers) {
+        if (bound.hasValue && strcmp(bound.pageName, activePage->name) == 0) {
+            values.emplace_back(bound.placeholder, bound.lastValue);
+        }
+    }
+    if (values.empty()) {
+        return "";
+    }
+    
+    size_t capacity = JSON_ARRAY_SIZE(values.size()) + values.size() * JSON_OBJECT_SIZE(2) + 64;
+    for (const auto& entry : values) {
+        capacity += entry.first.length() + entry.second.length() + 2;
+    }
+    DynamicJsonDocument doc(capacity);
+    JsonArray updateArray = doc.to<JsonArray>();
+    for (const auto& entry : values) {
+        JsonObject updateObj = updateArray.createNestedObject();
+        updateObj["target"] = entry.first.c_str();
+        updateObj["content"] = entry.second.c_str();
+    }
+    std::string updates;
+    serializeJson(doc, updates);
+    // A value must not be able to close the script element
+    for (size_t pos = updates.find("</"); pos != std::string::npos; pos = updates.find("</", pos + 3)) {
+        updates.insert(pos + 1, "\\");
+    }
+    return "\n<script>" + updates + ".forEach(function (u) {"
+           " var e = document.getElementById(u.target);"
+           " if (e) { if (e.tagName === 'INPUT') { e.value = u.content; } else { e.textContent = u.content; } } });"
+           "</script>";
+
+} // initialValuesScript()
+
+
+// the included files with [extension], in the order they were included,
+// but every script after the scripts it depends on
+std::vector<std::string> SPAmanager::bundleFiles(const char* extension)
+{
+    std::vector<std::string> files;
+    std::set<std::string> added;
+    size_t extensionLength = strlen(extension);
+    auto isBundled = [extension, extensionLength](const std::string& filePath) {
+        return filePath.length() > extensionLength 
+                && filePath.compare(filePath.length() - extensionLength, extensionLength, extension) == 0;
+    };
+    
+    std::function<void(const std::string&, size_t)> add = [&](const std::string& filePath, size_t depth) {
+        if (added.count(filePath) || depth > servedOrder.size()) {
+            return;  // Already in, or a circular dependency
+        }
+        auto deps = assetDependencies.find(filePath);
+        if (deps != assetDependencies.end()) {
+            for (const auto& dep : deps->second) {
+                for (const auto& candidate : servedOrder) {
+                    if (isBundled(candidate) && assetName(candidate) == dep) {
+                        add(candidate, depth + 1);
+                    }
+                }
+            }
+        }
+        if (added.insert(filePath).second) {
+            files.push_back(filePath);
+        }
+    };
+    for (const auto& filePath : servedOrder) {
+        if (isBundled(filePath)) {
+            add(filePath, 0);
+        }
+    }
+    return files;
+
+} // bundleFiles()
+
+
+std::string SPAmanager::bundleVersion(const char* extension)
+{
+    auto known = bundleVersions.find(extension);
+    if (known != bundleVersions.end()) {
+        return known->second;
+    }
+    // The bundle changes when one of its files, or their order, changes
+    uint32_t digest = 2166136261UL;
+    for (const auto& filePath : bundleFiles(extension)) {
+        std::string version = assetName(filePath) + assetVersion(filePath);
+        digest = computeDigest(version.c_str(), version.length(), digest);
+    }
+    std::string version = digestHex(digest);
+    bundleVersions[extension] = version;
+    return version;
+
+} // bundleVersion()
+
+
+// stream all included files with [extension] as one response
+void SPAmanager::sendBundle(const char* extension)
+{
+    bool isScript = strcmp(extension, ".js") == 0;
+    // Each script starts with an empty statement, so a missing ';' or a "use strict"
+    // at the top of one file does not change how the next file is read
+    const char* separator = isScript ? "\n;\n" : "\n";
+    std::vector<std::string> files = bundleFiles(extension);
+    std::string version = bundleVersion(extension);
+    std::string etag = "\"" + version + "\"";
+    
+    auto sendCacheHeaders = [this, &etag, &version]() {
+        server.sendHeader("ETag", etag.c_str());
+        if (server.hasArg("v") && server.arg("v") == version.c_str()) {
+            server.sendHeader("Cache-Control", "public, max-age=31536000, immutable");
+        } else {
+            server.sendHeader("Cache-Control", "no-cache");
+        }
+    };
+    if (server.header("If-None-Match").indexOf(etag.c_str()) >= 0) {
+        sendCacheHeaders();
+        server.send(304);
+        return;
+    }
+    
+    // Content-Length promises every byte, so every file is checked on the storage
+    // itself (not in the file cache) before the header goes out
+    std::vector<size_t> sizes;
+    size_t contentLength = 0;
+    for (const auto& filePath : files) {
+        SPAstorage::Stat info;
+        if (!defaultStorage.stat(filePath, info) || info.isDirectory) {
+            error(("sendBundle(): cannot open " + filePath).c_str());
+            server.sendHeader("Cache-Control", "no-store");
+            server.send(500, "text/plain", "Bundle incomplete");
+            return;
+        }
+        sizes.push_back(info.size);
+        contentLength += strlen(separator) + info.size;
+    }
+    sendCacheHeaders();
+    server.setContentLength(contentLength);
+    server.send(200, contentTypeFor(extension), "");
+    
+    char buffer[1024];
+    for (size_t i = 0; i < files.size(); i++) {
+        server.sendContent(separator, strlen(separator));
+        size_t remaining = sizes[i];
+        size_t offset = 0;
+        size_t bytesRead;
+        while (remaining > 0 
+                && (bytesRead = defaultStorage.read(files[i], offset, buffer, std::min(sizeof(buffer), remaining))) > 0) {
+            server.sendContent(buffer, bytesRead);
+            offset += bytesRead;
+            remaining -= bytesRead;
+        }
+        if (remaining > 0) {
+            // Closing the connection short of Content-Length makes the browser fail the
+            // request at once, instead of waiting for the rest and keeping a truncated bundle
+            error(("sendBundle(): " + files[i] + " is shorter than expected, closing the connection").c_str());
+            server.client().stop();
+            return;
+        }
+    }
+
+} // sendBundle()
+
+
+// read a small file (an index or a manifest) in one go
+std::string SPAmanager::readWholeFile(SPAstorage& from, const std::string& path)
+{
+    std::string content;
+    char buffer[256];
+    size_t bytesRead;
+    while ((bytesRead = from.read(path, content.length(), buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, bytesRead);
+    }
+    return content;
+
+} // readWholeFile()
+
+
+// load the assets.idx written by build_asset_manifest.py: one line "<name> <size> <digest>" per file
+bool SPAmanager::loadAssetManifest(const std::string& sysPath)
+{
+    assetManifest.clear();
+    std::string manifest = readWholeFile(defaultStorage, sysPath + "/assets.idx");
+    if (manifest.empty()) {
+        debug("loadAssetManifest(): no asset manifest, probing the system files");
+        return false;
+    }
+    
+    size_t lineStart = 0;
+    while (lineStart < manifest.length()) {
+        size_t lineEnd = manifest.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = manifest.length();
+        }
+        std::string line = manifest.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        size_t digestSep = line.rfind(' ');
+        size_t sizeSep = (digestSep == std::string::npos || digestSep == 0) ? std::string::npos : line.rfind(' ', digestSep - 1);
+        if (sizeSep == std::string::npos) {
+            continue;
+        }
+        AssetInfo asset;
+        asset.size = strtoul(line.c_str() + sizeSep + 1, nullptr, 10);
+        asset.digest = strtoul(line.c_str() + digestSep + 1, nullptr, 16);
+        assetManifest[sysPath + "/" + line.substr(0, sizeSep)] = asset;
+    }
+    debug(("loadAssetManifest(): " + std::to_string(assetManifest.size()) + " assets listed").c_str());
+    return !assetManifest.empty();
+
+} // loadAssetManifest()
+
+
+SPAmanager::BootTimings SPAmanager::getBootTimings() const
+{
+    return bootTimings;
+
+} // getBootTimings()
+
+
+// only the pages directory and the system path are cached
+bool SPAmanager::isCachedPath(const std::string& path) const
+{
+    for (const std::string& root : { normalizePath(PAGES_DIRECTORY), normalizePath(rootSystemPath) }) {
+        if (root.length() > 1 && path.compare(0, root.length(), root) == 0 
+                && (path.length() == root.length() || path[root.length()] == '/')) {
+            return true;
+        }
+    }
+    return false;
+
+} // isCachedPath()
+
+
+// read all entries of a directory in one walk
+void SPAmanager::cacheDirectory(const std::string& dirPath)
+{
+    cachedDirectories.insert(dirPath);
+    storageFor(dirPath)->list(dirPath, [this](const std::string& path, const SPAstorage::Stat& info) {
+        fileInfoCache[normalizePath(path)] = info;
+    });
+    debug(("cacheDirectory(): [" + dirPath + "] cached").c_str());
+
+} // cacheDirectory()
+
+
+SPAstorage::Stat SPAmanager::getFileInfo(const std::string& path)
+{
+    std::string filePath = normalizePath(path);
+    auto it = fileInfoCache.find(filePath);
+    if (it != fileInfoCache.end()) {
+        return it->second;
+    }
+    
+    // A manifest entry is checked against the filesystem once, when it is first used
+    auto asset = assetManifest.find(filePath);
+    if (asset != assetManifest.end()) {
+        SPAstorage::Stat info;
+        storageFor(filePath)->stat(filePath, info);
+        if (!info.exists || info.size != asset->second.size) {
+            error(("Asset manifest does not match [" + filePath + "], rebuild the filesystem image").c_str());
+        }
+        fileInfoCache[filePath] = info;
+        return info;
+    }
+    
+    size_t slash = filePath.find_last_of('/');
+    std::string dirPath = (slash == 0) ? "/" : filePath.substr(0, slash);
+    if (isCachedPath(dirPath)) {
+        if (cachedDirectories.count(dirPath) == 0) {
+            cacheDirectory(dirPath);
+            it = fileInfoCache.find(filePath);
+            if (it != fileInfoCache.end()) {
+                return it->second;
+            }
+        }
+        // The directory has been read, so the file is not there
+        return SPAstorage::Stat();
+    }
+    
+    // Outside the cached directories (or one of their roots): ask the filesystem
+    SPAstorage::Stat info;
+    storageFor(filePath)->stat(filePath, info);
+    if (isCachedPath(filePath)) {
+        fileInfoCache[filePath] = info;
+    }
+    return info;
+
+} // getFileInfo()
+
+
+bool SPAmanager::fileExists(const std::string& path)
+{
+    return getFileInfo(path).exists;
+
+} // fileExists()
+
+
+void SPAmanager::fileWritten(const std::string& path, size_t size)
+{
+    std::string filePath = normalizePath(path);
+    assetCache.remove(filePath);
+    if (!isCachedPath(filePath)) {
+        return;
+    }
+    SPAstorage::Stat info;
+    info.exists = true;
+    info.size = size;
+    info.lastWrite = time(nullptr);
+    fileInfoCache[filePath] = info;
+
+} // fileWritten()
+
+
+// forget all cached metadata, e.g. after files were uploaded by other code
+void SPAmanager::refreshFileCache()
+{
+    debug("refreshFileCache() called");
+    fileInfoCache.clear();
+    cachedDirectories.clear();
+    assetCache.clear();
+    //-- The files no longer have to match the image the manifest was built for
+    assetManifest.clear();
+    assetDigests.clear();
+    bundleVersions.clear();
+    for (auto& popup : popupTemplates) {
+        if (!popup.second.filePath.empty()) {
+            popup.second.digest.clear();
+        }
+    }
+
+} // refreshFileCache()
+
+
+// keep page files somewhere else than on LittleFS, call before the first addPage()
+void SPAmanager::setStorage(SPAstorage& pageStorage)
+{
+    debug("setStorage() called");
+    storage = &pageStorage;
+    refreshFileCache();
+    pageDigests.clear();
+    pageDigestsLoaded = false;
+
+} // setStorage()
+
+
+// write page content to file
+bool SPAmanager::writePageToFile(const char* pageName, const char* html) 
+{
+    if (!ensurePageDirectory()) {
+        error("Failed to create pages directory");
+        return false;
+    }
+    
+    std::string filePath = PAGES_DIRECTORY;
+    filePath += pageName;
+    filePath += ".html";
+
+    // Skip the write when the file already holds exactly this html
+    loadPageDigests();
+    size_t length = strlen(html);
+    uint32_t digest = computeDigest(html, length);
+    auto known = pageDigests.find(pageName);
+    if (known != pageDigests.end() && known->second == digest && fileExists(filePath)) {
+        debug(("writePageToFile(): [" + filePath + "] is unchanged, not rewritten").c_str());
+        return true;
+    }
+        
+    debug(("writePageToFile(): Writing page content to file: " + filePath).c_str());
+    if (!writeFileAtomic(filePath.c_str(), html, length)) {
+        return false;
+    }
+    
+    pageDigests[pageName] = digest;
+    savePageDigests();
+    pageContentChanged(pageName);
+    return true;
+
+} //  writePageToFile()
+
+
+// rewrite a page with a new opening tag for [element] (and optionally new text), streaming
+// the page through a fixed size buffer so peak memory does not depend on the page size
+bool SPAmanager::patchElement(Page& page, const ElementLocation& element, const std::string& tag, const char* text)
+{
+    PageSource source;
+    if (!openPageSource(page, source)) {
+        return false;
+    }
+    
+    // A static page only gets a file once it is modified
+    std::string filePath = page.filePath;
+    if (page.staticContent) {
+        if (!ensurePageDirectory()) {
+            error("Failed to create pages directory");
+            return false;
+        }
+        filePath = std::string(PAGES_DIRECTORY) + page.name + ".html";
+        debug(("patchElement(): static page [" + std::string(page.name) + "] modified, moving it to " + filePath).c_str());
+    }
+    
+    std::string tempPath = filePath + ".tmp";
+    size_t written = 0;
+    uint32_t digest = 2166136261UL;
+    auto emit = [this, &tempPath, &written, &digest](const char* data, size_t length) {
+        bool append = written > 0;
+        written += length;
+        digest = computeDigest(data, length, digest);
+        return storage->write(tempPath, data, length, append);
+    };
+    
+    char buffer[256];
+    bool skippingText = false;
+    bool writeSuccess = true;
+    size_t offset = 0;
+    size_t bytesRead;
+    
+    while (writeSuccess && (bytesRead = source.read(buffer, sizeof(buffer))) > 0) {
+        size_t i = 0;
+        while (writeSuccess && i < bytesRead) {
+            size_t pos = offset + i;
+            if (pos < element.tagStart) {
+                // Copy everything in front of the element
+                size_t length = std::min(bytesRead - i, element.tagStart - pos);
+                writeSuccess = emit(buffer + i, length);
+                i += length;
+            } else if (pos <= element.tagEnd) {
+                // Replace the opening tag
+                if (pos == element.tagStart) {
+                    writeSuccess = emit(tag.c_str(), tag.length());
+                    skippingText = (text != nullptr);
+                }
+                i += std::min(bytesRead - i, element.tagEnd + 1 - pos);
+            } else if (skippingText) {
+                // Drop the old text up to the next tag
+                const char* nextTag = (const char*)memchr(buffer + i, '<', bytesRead - i);
+                if (!nextTag) {
+                    i = bytesRead;
+                } else {
+                    writeSuccess = emit(text, strlen(text));
+                    skippingText = false;
+                    i = nextTag - buffer;
+                }
+            } else {
+                // Copy the rest
+                writeSuccess = emit(buffer + i, bytesRead - i);
+                i = bytesRead;
+            }
+        }
+        offset += bytesRead;
+    }
+    if (writeSuccess && skippingText) {
+        writeSuccess = emit(text, strlen(text));
+    }
+    
+    if (!writeSuccess || offset <= element.tagEnd) {
+        error(("Failed to write page file: " + filePath).c_str());
+        storage->remove(tempPath);
+        return false;
+    }
+    if (!replaceFile(tempPath, filePath.c_str(), written)) {
+        return false;
+    }
+    if (page.staticContent) {
+        page.setFilePath(filePath.c_str());
+        page.clearStaticContent();
+    }
+    reindexElements(page, element, tag.length(), text);
+    page.contentDigest = digest;
+    pageContentChanged(page.name);
+
+    // The file no longer matches the html it was created from;
+    // the index only needs to learn that once
+    auto known = pageDigests.find(page.name);
+    if (known != pageDigests.end() && known->second != 0) {
+        known->second = 0;
+        savePageDigests();
+    }
+    return true;
+
+} // patchElement()
+
+
+// set the value of an input, or the text of any other element
+bool SPAmanager::updatePlaceholder(Page& page, const char* placeholder, const std::string& value)
+{
+    // With a value store the page file is left alone, the value is appended to the log
+    if (valueStore.isOpen()) {
+        return valueStore.set(valueKey(page.name, placeholder), value);
+    }
+    ElementLocation element;
+    if (!locateElement(page, placeholder, element, false)) {
+        return false;
+    }
+    if (element.tag.compare(0, 6, "<input") == 0) {
+        std::string tag = element.tag;
+        setTagAttribute(tag, "value", value);
+        return patchElement(page, element, tag, nullptr);
+    }
+    return patchElement(page, element, element.tag, value.c_str());
+
+} // updatePlaceholder()
+
+
+void SPAmanager::addPage(const char* pageName, const char* html) {
+    debug(("addPage() called with pageName: " + std::string(pageName)).c_str());
+    
+    // Store first page name if this is the first page
+    if (pages.empty()) {
+        firstPageName = pageName;
+    }
+    
+    // Check if page already exists
+    auto it = std::find_if(pages.begin(), pages.end(),
+        [pageName](const Page& page) { return strcmp(page.name, pageName) == 0; });
+    
+    if (it != pages.end()) {
+        // Page exists, update content
+        if (writePageToFile(pageName, html)) {
+            // Update file path if needed
+            std::string filePath = PAGES_DIRECTORY;
+            filePath += pageName;
+            filePath += ".html";
             
             // Ensure the path starts with a slash
             if (filePath[0] != '/') {
                 filePath = "/" + filePath;
             }
             
-            page.setFilePath(filePath.c_str());
+            it->setFilePath(filePath.c_str());
+            it->elementIndex.clear();
+            it->contentDigest = computeDigest(html, strlen(html));
+            if (it->staticContent) {
+                it->clearStaticContent();
+                pageContentChanged(pageName);
+            }
+            updateClients();
+        } else {
+            error(("Failed to update page file for: " + std::string(pageName)).c_str());
+        }
+    } else {
+        // New page
+        if (writePageToFile(pageName, html)) {
+            Page page;
+            page.setName(pageName);
             
-            page.isVisible = false;
-            pages.push_back(page);
+            std::string filePath = PAGES_DIRECTORY;
+            filePath += pageName;
+            filePath += ".html";
             
-            if (!activePage) {
-                activePage = &pages.back();
-                pages.back().isVisible = true;
-                setHeaderTitle(pages.back().title);
-                updateClients();
+            // Ensure the path starts with a slash
+            if (filePath[0] != '/') {
+                filePath = "/" + filePath;
             }
+            
+            page.setFilePath(filePath.c_str());
+            page.contentDigest = computeDigest(html, strlen(html));
+            
+            page.isVisible = false;
+            registerPage(page);
         } else {
             error(("Failed to create page file for: " + std::string(pageName)).c_str());
             // Add error page instead
@@ -891,19 +2527,87 @@ void SPAmanager::addPage(const char* pageName, const char* html) {
             page.setName(pageName);
             page.isFileStorage = false;
             page.isVisible = false;
-            pages.push_back(page);
-            
-            if (!activePage) {
-                activePage = &pages.back();
-                pages.back().isVisible = true;
-                setHeaderTitle(pages.back().title);
-                updateClients();
-            }
+            registerPage(page);
         }
     }
 } // addPage()
 
 
+void SPAmanager::addStaticPage(const char* pageName, const char* html)
+{
+    debug(("addStaticPage() called with pageName: " + std::string(pageName)).c_str());
+    
+    // Store first page name if this is the first page
+    if (pages.empty()) {
+        firstPageName = pageName;
+    }
+
+    Page* existing = findPage(pageName);
+    if (existing) {
+        existing->clearStaticContent();
+        existing->staticContent = html;
+        existing->elementIndex.clear();
+        existing->contentDigest = 0;
+        existing->isFileStorage = false;
+        pageContentChanged(pageName);
+        if (existing == activePage) {
+            updateClients();
+        }
+        return;
+    }
+
+    Page page;
+    page.setName(pageName);
+    page.filePath[0] = '\0';
+    page.isFileStorage = false;
+    page.staticContent = html;
+    page.isVisible = false;
+    registerPage(page);
+
+} // addStaticPage()
+
+
+void SPAmanager::addCompiledPage(const SPAcompiledPage& compiled)
+{
+    debug(("addCompiledPage() called with pageName: " + std::string(compiled.name)).c_str());
+    
+    addStaticPage(compiled.name, compiled.html);
+    Page* page = findPage(compiled.name);
+    if (!page) {
+        return;
+    }
+    page->staticSize = compiled.size;
+    page->staticGzip = compiled.gzip;
+    page->staticGzipSize = compiled.gzip ? compiled.gzipSize : 0;
+    page->elementIndex.reserve(compiled.elementCount);
+    for (size_t i = 0; i < compiled.elementCount; i++) {
+        const SPAcompiledPage::Element& element = compiled.elements[i];
+        page->elementIndex.push_back({ element.id, element.tagStart, element.tagEnd, element.textEnd });
+    }
+
+} // addCompiledPage()
+
+
+void SPAmanager::registerPage(const Page& page)
+{
+    pages.push_back(page);
+
+    // push_back may have moved the pages, look the active one up again
+    if (activePage) {
+        activePage = findPage(activePageName.c_str());
+    }
+    if (!activePage) {
+        activePage = &pages.back();
+        activePageName = pages.back().name;
+        pages.back().isVisible = true;
+        setHeaderTitle(pages.back().title);
+        updatePageLifecycle();
+        updateClients();
+    }
+
+} // registerPage()
+
+
 
 void SPAmanager::setPageTitle(const char* pageName, const char* title)
 {
@@ -929,83 +2633,28 @@ void SPAmanager::setPlaceholder(const char* pageName, const char* placeholder, T
     
     for (auto& page : pages) {
         if (strcmp(page.name, pageName) == 0) {
-            if (!page.isFileStorage) {
+            if (!page.hasContent()) {
                 debug("Page is not using file storage, skipping placeholder update");
                 return;
             }
             
-            // Read the current content from file
-            std::string content = getPageContent(page);
-            if (content.empty() || content == DEFAULT_ERROR_PAGE) {
-                debug("Failed to read page content or using error page");
-                return;
-            }
-            
-            std::string idStr1 = std::string("id='") + placeholder + "'";
-            std::string idStr2 = std::string("id=\"") + placeholder + "\"";
-            size_t pos = content.find(idStr1);
-            if (pos == std::string::npos) {
-                pos = content.find(idStr2);
-            }
-            
-            if (pos != std::string::npos) {
-                // Check if it's an input field
-                size_t inputStart = content.rfind("<input", pos);
-                if (inputStart != std::string::npos && inputStart < pos) {
-                    // Find value attribute or closing bracket
-                    size_t valueStart1 = content.find("value='", inputStart);
-                    size_t valueStart2 = content.find("value=\"", inputStart);
-                    size_t closingBracket = content.find(">", inputStart);
+            // Update the page file
+            if (updatePlaceholder(page, placeholder, std::to_string(value))) {
+                // If this is the active page, update clients
+                if (activePage && strcmp(activePage->name, pageName) == 0) {
+                    const size_t capacity = JSON_OBJECT_SIZE(3) + 256;
+                    DynamicJsonDocument doc(capacity);
                     
-                    if (valueStart1 != std::string::npos && valueStart1 < closingBracket) {
-                        // Value attribute exists with single quotes
-                        size_t valueEnd = content.find("'", valueStart1 + 7);
-                        if (valueEnd != std::string::npos) {
-                            content.replace(valueStart1 + 7, valueEnd - (valueStart1 + 7), std::to_string(value));
-                        }
-                    } else if (valueStart2 != std::string::npos && valueStart2 < closingBracket) {
-                        // Value attribute exists with double quotes
-                        size_t valueEnd = content.find("\"", valueStart2 + 7);
-                        if (valueEnd != std::string::npos) {
-                            content.replace(valueStart2 + 7, valueEnd - (valueStart2 + 7), std::to_string(value));
-                        }
-                    } else {
-                        // No value attribute, insert before closing bracket
-                        content.insert(closingBracket, " value=\"" + std::to_string(value) + "\"");
-                    }
-                } else {
-                    // For non-input elements
-                    size_t start = content.find('>', pos) + 1;
-                    size_t end = content.find('<', start);
-                    if (start != std::string::npos && end != std::string::npos) {
-                        content.replace(start, end - start, std::to_string(value));
-                    }
-                }
-                
-                // Write the updated content back to the file
-                File pageFile = LittleFS.open(page.filePath, "w");
-                if (pageFile) {
-                    pageFile.print(content.c_str());
-                    pageFile.close();
+                    doc["type"] = "update";
+                    doc["target"] = placeholder;
+                    doc["content"] = std::to_string(value);
                     
-                    // If this is the active page, update clients
-                    if (activePage && strcmp(activePage->name, pageName) == 0) {
-                        const size_t capacity = JSON_OBJECT_SIZE(3) + 256;
-                        DynamicJsonDocument doc(capacity);
-                        
-                        doc["type"] = "update";
-                        doc["target"] = placeholder;
-                        doc["content"] = std::to_string(value);
-                        
-                        std::string output;
-                        serializeJson(doc, output);
-                        
-                        if (!output.empty()) {
-                            ws.broadcastTXT(output.c_str(), output.length());
-                        }
+                    std::string output;
+                    serializeJson(doc, output);
+                    
+                    if (!output.empty()) {
+                        queueFrame(LANE_CONTROL, output, placeholder);
                     }
-                } else {
-                    error(("Failed to open page file for writing: " + std::string(page.filePath)).c_str());
                 }
             }
             break;
@@ -1020,83 +2669,28 @@ void SPAmanager::setPlaceholder<const char*>(const char* pageName, const char* p
     
     for (auto& page : pages) {
         if (strcmp(page.name, pageName) == 0) {
-            if (!page.isFileStorage) {
+            if (!page.hasContent()) {
                 debug("Page is not using file storage, skipping placeholder update");
                 return;
             }
             
-            // Read the current content from file
-            std::string content = getPageContent(page);
-            if (content.empty() || content == DEFAULT_ERROR_PAGE) {
-                debug("Failed to read page content or using error page");
-                return;
-            }
-            
-            std::string idStr1 = std::string("id='") + placeholder + "'";
-            std::string idStr2 = std::string("id=\"") + placeholder + "\"";
-            size_t pos = content.find(idStr1);
-            if (pos == std::string::npos) {
-                pos = content.find(idStr2);
-            }
-            
-            if (pos != std::string::npos) {
-                // Check if it's an input field
-                size_t inputStart = content.rfind("<input", pos);
-                if (inputStart != std::string::npos && inputStart < pos) {
-                    // Find value attribute or closing bracket
-                    size_t valueStart1 = content.find("value='", inputStart);
-                    size_t valueStart2 = content.find("value=\"", inputStart);
-                    size_t closingBracket = content.find(">", inputStart);
+            // Update the page file
+            if (updatePlaceholder(page, placeholder, value)) {
+                // If this is the active page, update clients
+                if (activePage && strcmp(activePage->name, pageName) == 0) {
+                    const size_t capacity = JSON_OBJECT_SIZE(3) + 256;
+                    DynamicJsonDocument doc(capacity);
                     
-                    if (valueStart1 != std::string::npos && valueStart1 < closingBracket) {
-                        // Value attribute exists with single quotes
-                        size_t valueEnd = content.find("'", valueStart1 + 7);
-                        if (valueEnd != std::string::npos) {
-                            content.replace(valueStart1 + 7, valueEnd - (valueStart1 + 7), value);
-                        }
-                    } else if (valueStart2 != std::string::npos && valueStart2 < closingBracket) {
-                        // Value attribute exists with double quotes
-                        size_t valueEnd = content.find("\"", valueStart2 + 7);
-                        if (valueEnd != std::string::npos) {
-                            content.replace(valueStart2 + 7, valueEnd - (valueStart2 + 7), value);
-                        }
-                    } else {
-                        // No value attribute, insert before closing bracket
-                        content.insert(closingBracket, " value=\"" + std::string(value) + "\"");
-                    }
-                } else {
-                    // For non-input elements
-                    size_t start = content.find('>', pos) + 1;
-                    size_t end = content.find('<', start);
-                    if (start != std::string::npos && end != std::string::npos) {
-                        content.replace(start, end - start, value);
-                    }
-                }
-                
-                // Write the updated content back to the file
-                File pageFile = LittleFS.open(page.filePath, "w");
-                if (pageFile) {
-                    pageFile.print(content.c_str());
-                    pageFile.close();
+                    doc["type"] = "update";
+                    doc["target"] = placeholder;
+                    doc["content"] = value;
                     
-                    // If this is the active page, update clients
-                    if (activePage && strcmp(activePage->name, pageName) == 0) {
-                        const size_t capacity = JSON_OBJECT_SIZE(3) + 256;
-                        DynamicJsonDocument doc(capacity);
-                        
-                        doc["type"] = "update";
-                        doc["target"] = placeholder;
-                        doc["content"] = value;
-                        
-                        std::string output;
-                        serializeJson(doc, output);
-                        
-                        if (!output.empty()) {
-                            ws.broadcastTXT(output.c_str(), output.length());
-                        }
+                    std::string output;
+                    serializeJson(doc, output);
+                    
+                    if (!output.empty()) {
+                        queueFrame(LANE_CONTROL, output, placeholder);
                     }
-                } else {
-                    error(("Failed to open page file for writing: " + std::string(page.filePath)).c_str());
                 }
             }
             break;
@@ -1108,57 +2702,25 @@ SPAmanager::PlaceholderValue SPAmanager::getPlaceholder(const char* pageName, co
     debug((std::string("getPlaceholder() called with pageName: ") + pageName + ", placeholder: " + placeholder).c_str());
     std::string value = "";
     
+    if (valueStore.isOpen() && valueStore.get(valueKey(pageName, placeholder), value)) {
+        return PlaceholderValue(value.c_str());
+    }
+    
     for (const auto& page : pages) {
         if (strcmp(page.name, pageName) == 0) {
-            if (!page.isFileStorage) {
+            if (!page.hasContent()) {
                 debug("Page is not using file storage, returning empty placeholder");
                 return PlaceholderValue("");
             }
             
-            // Read the current content from file
-            std::string content = getPageContent(page);
-            if (content.empty() || content == DEFAULT_ERROR_PAGE) {
-                debug("Failed to read page content or using error page");
-                return PlaceholderValue("");
-            }
-            
-            std::string idStr1 = std::string("id='") + placeholder + "'";
-            std::string idStr2 = std::string("id=\"") + placeholder + "\"";
-            size_t pos = content.find(idStr1);
-            if (pos == std::string::npos) {
-                pos = content.find(idStr2);
-            }
-            
-            if (pos != std::string::npos) {
+            ElementLocation element;
+            if (locateElement(page, placeholder, element, true)) {
                 // Check if it's an input field
-                size_t inputStart = content.rfind("<input", pos);
-                if (inputStart != std::string::npos && inputStart < pos) {
-                    // Find value attribute with single or double quotes
-                    size_t valueStart1 = content.find("value='", inputStart);
-                    size_t valueStart2 = content.find("value=\"", inputStart);
-                    size_t closingBracket = content.find(">", inputStart);
-                    
-                    if (valueStart1 != std::string::npos && valueStart1 < closingBracket) {
-                        valueStart1 += 7; // Length of "value='"
-                        size_t valueEnd = content.find("'", valueStart1);
-                        if (valueEnd != std::string::npos) {
-                            value = content.substr(valueStart1, valueEnd - valueStart1);
-                        }
-                    } else if (valueStart2 != std::string::npos && valueStart2 < closingBracket) {
-                        valueStart2 += 7; // Length of "value=\""
-                        size_t valueEnd = content.find("\"", valueStart2);
-                        if (valueEnd != std::string::npos) {
-                            value = content.substr(valueStart2, valueEnd - valueStart2);
-                        }
-                    }
+                if (element.tag.compare(0, 6, "<input") == 0) {
+                    getTagAttribute(element.tag, "value", value);
                 } else {
                     // For non-input elements, get content between tags
-                    size_t start = content.find('>', pos) + 1;
-                    size_t end = content.find('<', start);
-                    
-                    if (start != std::string::npos && end != std::string::npos) {
-                        value = content.substr(start, end - start);
-                    }
+                    value = element.text;
                 }
                 // Trim whitespace
                 value.erase(0, value.find_first_not_of(" \t\n\r\f\v"));
@@ -1201,6 +2763,7 @@ void SPAmanager::activatePage(const char* pageName)
         }
         page.isVisible = shouldBeVisible;
     }
+    updatePageLifecycle();
     updateClients();
 }
 
@@ -1256,7 +2819,7 @@ void SPAmanager::addMenuItem(const char* pageName, const char* menuName, const c
             item.setName(itemName);
             item.setUrl(nullptr);
             item.callback = callback;
-            menu.items.push_back(item);
+            addItemToMenu(menu, item);
             if (activePage && strcmp(activePage->name, pageName) == 0) {
                 updateClients();
             }
@@ -1290,7 +2853,7 @@ void SPAmanager::addMenuItem(const char* pageName, const char* menuName, const c
             MenuItem item;
             item.setName(itemName);
             item.setUrl(url);
-            menu.items.push_back(item);
+            addItemToMenu(menu, item);
             if (activePage && strcmp(activePage->name, pageName) == 0) {
                 updateClients();
             }
@@ -1325,7 +2888,7 @@ void SPAmanager::addMenuItem(const char* pageName, const char* menuName, const c
       item.setName(itemName);
       item.setUrl(nullptr);
       item.callback = [callback, param]() { callback(param); };
-      menu.items.push_back(item);
+      addItemToMenu(menu, item);
       if (activePage && strcmp(activePage->name, pageName) == 0) {
         updateClients();
       }
@@ -1338,6 +2901,44 @@ void SPAmanager::addMenuItemPopup(const char* pageName, const char* menuName, co
 {
   debug(("addMenuItemPopup() called with pageName: " + std::string(pageName) + ", menuName: " + std::string(menuName) + ", menuItem: " + std::string(menuItem)).c_str());
   
+  PopupTemplate popup;
+  popup.html = popupMenu;
+  popup.callback = callback;
+  addMenuItemPopupTemplate(pageName, menuName, menuItem, popup);
+}
+
+
+void SPAmanager::addMenuItemPopupFile(const char* pageName, const char* menuName, const char* menuItem, const char* popupFile, std::function<void(const std::map<std::string, std::string>&)> callback)
+{
+  debug(("addMenuItemPopupFile() called with pageName: " + std::string(pageName) + ", menuName: " + std::string(menuName) + ", menuItem: " + std::string(menuItem) + ", popupFile: " + std::string(popupFile)).c_str());
+  
+  PopupTemplate popup;
+  popup.filePath = normalizePath(popupFile);
+  popup.callback = callback;
+  addMenuItemPopupTemplate(pageName, menuName, menuItem, popup);
+}
+
+
+// the id a popup of a menu item is known by in the browser
+std::string SPAmanager::menuPopupId(const char* menuName, const char* itemName)
+{
+  std::string popupId = std::string("popup_") + menuName + "_" + itemName;
+  
+  // Replace any spaces with underscores in the ID
+  for (size_t i = 0; i < popupId.length(); i++)
+  {
+    if (popupId[i] == ' ')
+    {
+      popupId[i] = '_';
+    }
+  }
+  return popupId;
+
+} // menuPopupId()
+
+
+void SPAmanager::addMenuItemPopupTemplate(const char* pageName, const char* menuName, const char* menuItem, const PopupTemplate& popup)
+{
   // Check if the page exists
   if (!pageExists(pageName))
   {
@@ -1356,48 +2957,161 @@ void SPAmanager::addMenuItemPopup(const char* pageName, const char* menuName, co
   {
     if (strcmp(menu.name, menuName) == 0 && strcmp(menu.pageName, pageName) == 0)
     {
-      // Create a unique ID for this popup
-      std::string popupId = std::string("popup_") + menuName + "_" + menuItem;
-      
-      // Replace any spaces with underscores in the ID
-      for (size_t i = 0; i < popupId.length(); i++)
-      {
-        if (popupId[i] == ' ')
-        {
-          popupId[i] = '_';
-        }
-      }
+      std::string popupId = menuPopupId(menuName, menuItem);
+      registerPopupTemplate(popupId, popup);
       
-      // Create a menu item with a callback that calls the show popup function
+      // A click only sends the id, the client has the content after the first time
       MenuItem item;
       item.setName(menuItem);
       item.setUrl(nullptr);
-      item.popupCallback = callback;
-      
-      // Create a lambda that will call our JavaScript function with the popup content
-      item.callback = [this, popupId, popupMenu]() {
-        // Create a JSON object with the popup content and configuration
-        const size_t capacity = JSON_OBJECT_SIZE(3) + strlen(popupMenu) + 256;
-        DynamicJsonDocument doc(capacity);
-        
-        doc["event"] = "showPopup";
-        doc["id"] = popupId;
-        doc["content"] = popupMenu;
-        
-        std::string output;
-        serializeJson(doc, output);
-        
-        if (!output.empty() && hasConnectedClient)
-        {
-          ws.broadcastTXT(output.c_str(), output.length());
-        }
+      item.callback = [this, popupId]() {
+        openPopup(popupId.c_str());
       };
       
-      menu.items.push_back(item);
+      addItemToMenu(menu, item);
       break;
     }
   }
-}
+
+} // addMenuItemPopupTemplate()
+
+
+void SPAmanager::addPopupTemplate(const char* popupId, const char* html, std::function<void(const std::map<std::string, std::string>&)> callback)
+{
+  debug(("addPopupTemplate() called with popupId: " + std::string(popupId)).c_str());
+  PopupTemplate popup;
+  popup.html = html;
+  popup.callback = callback;
+  registerPopupTemplate(popupId, popup);
+
+} // addPopupTemplate()
+
+
+void SPAmanager::addPopupTemplateFile(const char* popupId, const char* filePath, std::function<void(const std::map<std::string, std::string>&)> callback)
+{
+  debug(("addPopupTemplateFile() called with popupId: " + std::string(popupId) + ", filePath: " + std::string(filePath)).c_str());
+  PopupTemplate popup;
+  popup.filePath = normalizePath(filePath);
+  popup.callback = callback;
+  registerPopupTemplate(popupId, popup);
+
+} // addPopupTemplateFile()
+
+
+// a popup keeps its id when it is registered again
+void SPAmanager::registerPopupTemplate(const std::string& popupId, const PopupTemplate& popup)
+{
+  auto existing = popupTemplates.find(popupId);
+  if (existing != popupTemplates.end())
+  {
+    uint16_t id = existing->second.id;
+    existing->second = popup;
+    existing->second.id = id;
+    return;
+  }
+  PopupTemplate& added = popupTemplates[popupId];
+  added = popup;
+  added.id = (uint16_t)popupTable.size();
+  popupTable.push_back(&added);
+
+} // registerPopupTemplate()
+
+
+// give [item] the next id and add it to [menu]
+void SPAmanager::addItemToMenu(Menu& menu, MenuItem& item)
+{
+  item.id = (uint16_t)menuItemTable.size();
+  menuItemTable.push_back({ (uint16_t)(&menu - menus.data()), (uint16_t)menu.items.size() });
+  menu.items.push_back(item);
+
+} // addItemToMenu()
+
+
+const std::string& SPAmanager::popupDigest(PopupTemplate& popup)
+{
+  if (popup.digest.empty()) {
+    if (popup.html) {
+      popup.digest = digestHex(computeDigest(popup.html, strlen(popup.html)));
+    } else {
+      popup.digest = assetVersion(popup.filePath);
+    }
+  }
+  return popup.digest;
+
+} // popupDigest()
+
+
+// open a registered popup: the content only goes out when the client does not have
+// this version of it yet, [values] fill the elements with these ids in the popup
+void SPAmanager::openPopup(const char* popupId, const std::map<std::string, std::string>& values)
+{
+  debug(("openPopup() called with popupId: " + std::string(popupId)).c_str());
+  auto popup = popupTemplates.find(popupId);
+  if (popup == popupTemplates.end())
+  {
+    error(("openPopup(): ERROR: Popup [" + std::string(popupId) + "] is not registered").c_str());
+    return;
+  }
+  if (!hasConnectedClient)
+  {
+    return;
+  }
+  
+  const std::string& digest = popupDigest(popup->second);
+  // No reference into clientFlows is kept across queueFrame()
+  const ClientFlow& flow = clientFlows[currentClient];
+  auto held = flow.popupDigests.find(popupId);
+  bool sendContent = (held == flow.popupDigests.end() || held->second != digest);
+  std::string fileContent;
+  const char* content = popup->second.html;
+  if (sendContent && !content)
+  {
+    fileContent = readWholeFile(defaultStorage, popup->second.filePath);
+    if (fileContent.empty())
+    {
+      error(("openPopup(): ERROR: cannot read " + popup->second.filePath).c_str());
+      return;
+    }
+    content = fileContent.c_str();
+  }
+  
+  size_t capacity = JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(values.size()) + strlen(popupId) + digest.length() + 64;
+  for (const auto& value : values)
+  {
+    capacity += value.first.length() + value.second.length() + 2;
+  }
+  if (sendContent)
+  {
+    capacity += strlen(content) + 1;
+  }
+  DynamicJsonDocument doc(capacity);
+  doc["event"] = "showPopup";
+  doc["id"] = popupId;
+  doc["key"] = popup->second.id;
+  doc["digest"] = digest.c_str();
+  if (sendContent)
+  {
+    doc["content"] = content;
+  }
+  JsonObject valueObj = doc.createNestedObject("values");
+  for (const auto& value : values)
+  {
+    valueObj[value.first.c_str()] = value.second.c_str();
+  }
+  
+  std::string output;
+  serializeJson(doc, output);
+  if (!output.empty())
+  {
+    queueFrame(LANE_CONTROL, output);
+    auto sentTo = clientFlows.find(currentClient);
+    if (sendContent && hasConnectedClient && sentTo != clientFlows.end())
+    {
+      sentTo->second.popupDigests[popupId] = digest;
+    }
+  }
+
+} // openPopup()
 
 
 void SPAmanager::enableMenuItem(const char* pageName, const char* menuName, const char* itemName)
@@ -1455,204 +3169,105 @@ void SPAmanager::disableMenuItem(const char* pageName, const char* menuName, con
     {
       error(("disableMenuItem(): ERROR: Menu [" + std::string(menuName) + "] does not exist on page [" + std::string(pageName) + "]").c_str());
       return;
-    }
-    
-    for (auto& menu : menus) 
-    {
-        if (strcmp(menu.name, menuName) == 0 && strcmp(menu.pageName, pageName) == 0) 
-        {
-            for (auto& item : menu.items) 
-            {
-                if (strcmp(item.name, itemName) == 0) 
-                {
-                    item.disabled = true;
-                    if (activePage && strcmp(activePage->name, pageName) == 0) 
-                    {
-                        updateClients();
-                    }
-                    break;
-                }
-            }
-            break;
-        }
-    }
-}
-
-void SPAmanager::enableID(const char* pageName, const char* id)
-{
-  debug(("enableID() called with pageName: " + std::string(pageName) + ", id: " + std::string(id)).c_str());
-  for (auto& page : pages)
-  {
-    if (strcmp(page.name, pageName) == 0)
-    {
-      if (!page.isFileStorage) {
-        debug("Page is not using file storage, skipping ID update");
-        return;
-      }
-      
-      // Read the current content from file
-      std::string content = getPageContent(page);
-      if (content.empty() || content == DEFAULT_ERROR_PAGE) {
-        debug("Failed to read page content or using error page");
-        return;
-      }
-      
-      std::string idStr1 = std::string("id='") + id + "'";
-      std::string idStr2 = std::string("id=\"") + id + "\"";
-      size_t pos = content.find(idStr1);
-      if (pos == std::string::npos)
-      {
-        pos = content.find(idStr2);
-      }
-      
-      if (pos != std::string::npos)
-      {
-        // Find the style attribute or the end of the tag
-        size_t stylePos = content.find("style", pos);
-        size_t tagEnd = content.find(">", pos);
-        
-        if (stylePos != std::string::npos && stylePos < tagEnd)
-        {
-          // Style attribute exists, update display property
-          size_t displayPos = content.find("display:", stylePos);
-          if (displayPos != std::string::npos && displayPos < tagEnd)
-          {
-            // Replace existing display value
-            size_t valueStart = displayPos + 8;
-            size_t valueEnd = content.find(";", valueStart);
-            if (valueEnd == std::string::npos || valueEnd > tagEnd)
-            {
-              valueEnd = content.find("\"", valueStart);
-            }
-            if (valueEnd != std::string::npos && valueEnd > valueStart)
-            {
-              content.replace(valueStart, valueEnd - valueStart, "block");
-            }
-          }
-          else
-          {
-            // Add display property to existing style
-            size_t quotePos = content.find("\"", stylePos);
-            if (quotePos != std::string::npos && quotePos < tagEnd)
+    }
+    
+    for (auto& menu : menus) 
+    {
+        if (strcmp(menu.name, menuName) == 0 && strcmp(menu.pageName, pageName) == 0) 
+        {
+            for (auto& item : menu.items) 
             {
-              content.insert(quotePos, ";display:block");
+                if (strcmp(item.name, itemName) == 0) 
+                {
+                    item.disabled = true;
+                    if (activePage && strcmp(activePage->name, pageName) == 0) 
+                    {
+                        updateClients();
+                    }
+                    break;
+                }
             }
-          }
-        }
-        else
-        {
-          // No style attribute, add it before the end of the tag
-          content.insert(tagEnd, " style=\"display:block\"");
-        }
-        
-        // Write the updated content back to the file
-        File pageFile = LittleFS.open(page.filePath, "w");
-        if (pageFile) {
-          pageFile.print(content.c_str());
-          pageFile.close();
-          
-          if (activePage && strcmp(activePage->name, pageName) == 0)
-          {
-            updateClients();
-          }
-        } else {
-          error(("Failed to open page file for writing: " + std::string(page.filePath)).c_str());
+            break;
         }
-      }
-      break;
     }
-  }
+}
+
+void SPAmanager::enableID(const char* pageName, const char* id)
+{
+  debug(("enableID() called with pageName: " + std::string(pageName) + ", id: " + std::string(id)).c_str());
+  setElementDisplay(pageName, id, "block");
+
 } // enableID()
 
 void SPAmanager::disableID(const char* pageName, const char* id)
 {
   debug(("disableID() called with pageName: " + std::string(pageName) + ", id: " + std::string(id)).c_str());
-  for (auto& page : pages)
+  setElementDisplay(pageName, id, "none");
+
+} // disableID()
+
+
+// set the display style of the element with [id], keeping the rest of its style
+void SPAmanager::setElementDisplay(const char* pageName, const char* id, const char* display)
+{
+  Page* page = findPage(pageName);
+  if (!page) {
+    return;
+  }
+  if (!page->hasContent()) {
+    debug("Page is not using file storage, skipping ID update");
+    return;
+  }
+  
+  ElementLocation element;
+  if (!locateElement(*page, id, element, false)) {
+    return;
+  }
+  
+  std::string tag = element.tag;
+  std::string displayValue = std::string("display:") + display;
+  char quote;
+  size_t styleStart = findTagAttribute(tag, "style", quote);
+  if (styleStart == std::string::npos)
   {
-    if (strcmp(page.name, pageName) == 0)
+    // No style attribute, add it
+    setTagAttribute(tag, "style", displayValue);
+  }
+  else
+  {
+    size_t styleEnd = tag.find(quote, styleStart);
+    size_t displayPos = tag.find("display:", styleStart);
+    if (displayPos != std::string::npos && displayPos < styleEnd)
     {
-      if (!page.isFileStorage) {
-        debug("Page is not using file storage, skipping ID update");
-        return;
-      }
-      
-      // Read the current content from file
-      std::string content = getPageContent(page);
-      if (content.empty() || content == DEFAULT_ERROR_PAGE) {
-        debug("Failed to read page content or using error page");
-        return;
-      }
-      
-      std::string idStr1 = std::string("id='") + id + "'";
-      std::string idStr2 = std::string("id=\"") + id + "\"";
-      size_t pos = content.find(idStr1);
-      if (pos == std::string::npos)
-      {
-        pos = content.find(idStr2);
-      }
-      
-      if (pos != std::string::npos)
+      // Replace existing display value
+      size_t valueStart = displayPos + 8;
+      size_t valueEnd = tag.find(";", valueStart);
+      if (valueEnd == std::string::npos || valueEnd > styleEnd)
       {
-        // Find the style attribute or the end of the tag
-        size_t stylePos = content.find("style", pos);
-        size_t tagEnd = content.find(">", pos);
-        
-        if (stylePos != std::string::npos && stylePos < tagEnd)
-        {
-          // Style attribute exists, update display property
-          size_t displayPos = content.find("display:", stylePos);
-          if (displayPos != std::string::npos && displayPos < tagEnd)
-          {
-            // Replace existing display value
-            size_t valueStart = displayPos + 8;
-            size_t valueEnd = content.find(";", valueStart);
-            if (valueEnd == std::string::npos || valueEnd > tagEnd)
-            {
-              valueEnd = content.find("\"", valueStart);
-            }
-            if (valueEnd != std::string::npos && valueEnd > valueStart)
-            {
-              content.replace(valueStart, valueEnd - valueStart, "none");
-            }
-          }
-          else
-          {
-            // Add display property to existing style
-            size_t quotePos = content.find("\"", stylePos);
-            if (quotePos != std::string::npos && quotePos < tagEnd)
-            {
-              content.insert(quotePos, ";display:none");
-            }
-          }
-        }
-        else
-        {
-          // No style attribute, add it before the end of the tag
-          content.insert(tagEnd, " style=\"display:none\"");
-        }
-        
-        // Write the updated content back to the file
-        File pageFile = LittleFS.open(page.filePath, "w");
-        if (pageFile) {
-          pageFile.print(content.c_str());
-          pageFile.close();
-          
-          if (activePage && strcmp(activePage->name, pageName) == 0)
-          {
-            updateClients();
-          }
-        } else {
-          error(("Failed to open page file for writing: " + std::string(page.filePath)).c_str());
-        }
+        valueEnd = styleEnd;
       }
-      break;
+      tag.replace(valueStart, valueEnd - valueStart, display);
+    }
+    else
+    {
+      // Add display property to existing style
+      tag.insert(styleStart, displayValue + ";");
+    }
+  }
+  
+  // Write the updated content back to the file
+  if (patchElement(*page, element, tag, nullptr)) {
+    if (activePage && strcmp(activePage->name, pageName) == 0)
+    {
+      updateClients();
     }
   }
-} // disableID()
 
+} // setElementDisplay()
 
 
-void SPAmanager::includeJsFile(const std::string &path2JsFile)
+
+void SPAmanager::includeJsFile(const std::string &path2JsFile, const std::vector<std::string>& dependsOn)
 {
   std::string sanitizedJsPath = path2JsFile;
   
@@ -1706,19 +3321,24 @@ void SPAmanager::includeJsFile(const std::string &path2JsFile)
   //}
 
   //-- Check if the file exists
-  if (!LittleFS.exists(sanitizedJsPath.c_str())) {
+  if (!fileExists(sanitizedJsPath)) {
     error(("File does not exist: " + sanitizedJsPath).c_str());
     return;
   }
 
-  //-- Debugging `serveStatic()` call
-  debug(("includeJsFile(): server.serveStatic(" + fName + ", LittleFS, " + sanitizedJsPath + ")").c_str());
+  //-- Serve the script file, or its gzipped sibling
+  serveAsset(fName, sanitizedJsPath);
 
-  //-- Serve the script file statically
-  server.serveStatic(fName.c_str(), LittleFS, sanitizedJsPath.c_str());
+  //-- The client runs this script only after the scripts it depends on
+  for (const auto& dependency : dependsOn)
+  {
+    assetDependencies[sanitizedJsPath].push_back(assetName(dependency));
+  }
 
   //-- Add to served files
   servedFiles.insert(sanitizedJsPath);
+  servedOrder.push_back(sanitizedJsPath);
+  bundleVersions.clear();
 
 } // includeJsFile()
 
@@ -1780,19 +3400,18 @@ void SPAmanager::includeCssFile(const std::string &path2CssFile)
     error(("filesystem unavailable, CSS file: " + sanitizedCssPath).c_str());
     //return;
   }
-  if (!LittleFS.exists(sanitizedCssPath.c_str())) {
+  if (!fileExists(sanitizedCssPath)) {
     error(("CSS file does not exist: " + sanitizedCssPath).c_str());
     return;
   }
 
-  //-- Debugging `serveStatic()` call
-  debug(("includeCssFile(): server.serveStatic(" + fName + ", LittleFS, " + sanitizedCssPath + ")").c_str());
-
-  //-- Serve the CSS file statically
-  server.serveStatic(fName.c_str(), LittleFS, sanitizedCssPath.c_str());
+  //-- Serve the CSS file, or its gzipped sibling
+  serveAsset(fName, sanitizedCssPath);
 
   //-- Add to served files
   servedFiles.insert(sanitizedCssPath);
+  servedOrder.push_back(sanitizedCssPath);
+  bundleVersions.clear();
 
 } // includeCssFile()
 
@@ -1814,7 +3433,7 @@ void SPAmanager::callJsFunction(const char* functionName)
 
     if (!output.empty())
     {
-      ws.broadcastTXT(output.c_str(), output.length());
+      queueFrame(LANE_CONTROL, output);
     }
   }
 } // callJsFunction()
@@ -1837,7 +3456,7 @@ void SPAmanager::callJsFunction(const char* functionName, const char* parameter)
 
     if (!output.empty())
     {
-      ws.broadcastTXT(output.c_str(), output.length());
+      queueFrame(LANE_CONTROL, output);
     }
   }
 } // callJsFunction() - parameterized version
@@ -1942,6 +3561,19 @@ bool SPAmanager::pageExists(const char* pageName) const
   return false;
 }
 
+// Helper method to find a page by name
+SPAmanager::Page* SPAmanager::findPage(const char* pageName)
+{
+  for (auto& page : pages)
+  {
+    if (strcmp(page.name, pageName) == 0)
+    {
+      return &page;
+    }
+  }
+  return nullptr;
+}
+
 // Helper method to check if a menu exists on a specific page
 bool SPAmanager::menuExists(const char* pageName, const char* menuName) const
 {
@@ -1962,6 +3594,332 @@ void SPAmanager::pageIsLoaded(std::function<void()> callback)
   pageLoadedCallback = callback;
 }
 
+void SPAmanager::onPageEnter(const char* pageName, std::function<void()> callback)
+{
+  debug(("onPageEnter() called with pageName: " + std::string(pageName)).c_str());
+  Page* page = findPage(pageName);
+  if (!page)
+  {
+    error(("onPageEnter(): ERROR: Page [" + std::string(pageName) + "] does not exist").c_str());
+    return;
+  }
+  page->onEnter = callback;
+
+  // The page may already be in view
+  if (callback && enteredPageName == pageName)
+  {
+    callback();
+  }
+}
+
+void SPAmanager::onPageLeave(const char* pageName, std::function<void()> callback)
+{
+  debug(("onPageLeave() called with pageName: " + std::string(pageName)).c_str());
+  Page* page = findPage(pageName);
+  if (!page)
+  {
+    error(("onPageLeave(): ERROR: Page [" + std::string(pageName) + "] does not exist").c_str());
+    return;
+  }
+  page->onLeave = callback;
+}
+
+// Fire onLeave/onEnter when the page that is actually in view changes.
+// A page is only "in view" when it is active and a client is connected.
+void SPAmanager::updatePageLifecycle()
+{
+  std::string viewedPage = (hasConnectedClient && activePage) ? activePage->name : "";
+  if (viewedPage == enteredPageName)
+  {
+    return;
+  }
+  // Update state first so a callback that activates another page sees the new situation
+  std::string previousPage = enteredPageName;
+  enteredPageName = viewedPage;
+
+  if (!previousPage.empty())
+  {
+    Page* page = findPage(previousPage.c_str());
+    if (page && page->onLeave)
+    {
+      debug(("updatePageLifecycle(): leaving page [" + previousPage + "]").c_str());
+      page->onLeave();
+    }
+  }
+  if (!viewedPage.empty())
+  {
+    Page* page = findPage(viewedPage.c_str());
+    if (page && page->onEnter)
+    {
+      debug(("updatePageLifecycle(): entering page [" + viewedPage + "]").c_str());
+      page->onEnter();
+    }
+  }
+
+} // updatePageLifecycle()
+
+void SPAmanager::bindProvider(const char* pageName, const char* placeholder, uint32_t intervalMs, std::function<std::string()> provider)
+{
+  debug(("bindProvider() called with pageName: " + std::string(pageName) + ", placeholder: " + std::string(placeholder) + ", interval: " + std::to_string(intervalMs)).c_str());
+
+  // Check if the page exists
+  if (!pageExists(pageName))
+  {
+    error(("bindProvider(): ERROR: Page [" + std::string(pageName) + "] does not exist").c_str());
+    return;
+  }
+  if (!provider)
+  {
+    error("bindProvider(): ERROR: provider function is empty");
+    return;
+  }
+
+  // Rebinding the same placeholder replaces the previous provider
+  for (auto& bound : providers)
+  {
+    if (strcmp(bound.pageName, pageName) == 0 && strcmp(bound.placeholder, placeholder) == 0)
+    {
+      bound.intervalMs = intervalMs;
+      bound.provider = provider;
+      bound.wasActive = false;
+      bound.hasValue = false;
+      return;
+    }
+  }
+
+  ValueProvider bound;
+  bound.setPageName(pageName);
+  bound.setPlaceholder(placeholder);
+  bound.intervalMs = intervalMs;
+  bound.provider = provider;
+  providers.push_back(bound);
+
+} // bindProvider()
+
+// Formatting helpers for bound variables
+static std::string formatBoundValue(int value, uint8_t) { return std::to_string(value); }
+static std::string formatBoundValue(unsigned int value, uint8_t) { return std::to_string(value); }
+static std::string formatBoundValue(long value, uint8_t) { return std::to_string(value); }
+static std::string formatBoundValue(unsigned long value, uint8_t) { return std::to_string(value); }
+static std::string formatBoundValue(double value, uint8_t decimals)
+{
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+  return std::string(buffer);
+}
+
+template <typename T>
+void SPAmanager::bind(const char* pageName, const char* placeholder, const T* variable, uint8_t decimals)
+{
+  debug(("bind() called with pageName: " + std::string(pageName) + ", placeholder: " + std::string(placeholder)).c_str());
+  if (!variable)
+  {
+    error("bind(): ERROR: variable pointer is null");
+    return;
+  }
+  addBinding(pageName, placeholder, [variable, decimals]() { return formatBoundValue(*variable, decimals); });
+
+} // bind()
+
+// Explicit template instantiations for bind
+template void SPAmanager::bind<int>(const char*, const char*, const int*, uint8_t);
+template void SPAmanager::bind<unsigned int>(const char*, const char*, const unsigned int*, uint8_t);
+template void SPAmanager::bind<long>(const char*, const char*, const long*, uint8_t);
+template void SPAmanager::bind<unsigned long>(const char*, const char*, const unsigned long*, uint8_t);
+template void SPAmanager::bind<float>(const char*, const char*, const float*, uint8_t);
+template void SPAmanager::bind<double>(const char*, const char*, const double*, uint8_t);
+
+void SPAmanager::addBinding(const char* pageName, const char* placeholder, std::function<std::string()> format)
+{
+  // Check if the page exists
+  if (!pageExists(pageName))
+  {
+    error(("bind(): ERROR: Page [" + std::string(pageName) + "] does not exist").c_str());
+    return;
+  }
+
+  // Rebinding the same placeholder replaces the previous variable
+  for (auto& bound : bindings)
+  {
+    if (strcmp(bound.pageName, pageName) == 0 && strcmp(bound.placeholder, placeholder) == 0)
+    {
+      bound.format = format;
+      bound.hasValue = false;
+      return;
+    }
+  }
+
+  VariableBinding bound;
+  bound.setPageName(pageName);
+  bound.setPlaceholder(placeholder);
+  bound.format = format;
+  bindings.push_back(bound);
+
+} // addBinding()
+
+void SPAmanager::setBindingRefreshRate(uint32_t intervalMs)
+{
+  debug(("setBindingRefreshRate() called with interval: " + std::to_string(intervalMs)).c_str());
+  bindingRefreshMs = intervalMs;
+}
+
+void SPAmanager::setClientOptions(ClientLogLevel logLevel, bool useWorker)
+{
+  debug(("setClientOptions() called with logLevel: " + std::to_string(logLevel) + ", useWorker: " + std::to_string(useWorker)).c_str());
+  clientLogLevel = logLevel;
+  clientUsesWorker = useWorker;
+  if (hasConnectedClient)
+  {
+    sendClientOptions();
+  }
+
+} // setClientOptions()
+
+// how the browser logs and where it parses the frames
+void SPAmanager::sendClientOptions()
+{
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(3) + 32);
+  doc["type"] = "clientOptions";
+  doc["logLevel"] = (uint8_t)clientLogLevel;
+  doc["worker"] = clientUsesWorker;
+  std::string output;
+  serializeJson(doc, output);
+  queueFrame(LANE_CONTROL, output);
+
+} // sendClientOptions()
+
+void SPAmanager::loop()
+{
+  server.handleClient();
+  ws.loop();
+  handleProviders();
+  handleBindings(false);
+  processOutbound();
+
+} // loop()
+
+void SPAmanager::handleBindings(bool force)
+{
+  if (bindings.empty() || !hasConnectedClient || !activePage)
+  {
+    return;
+  }
+  if (!force && (millis() - lastBindingRefresh) < bindingRefreshMs)
+  {
+    return;
+  }
+  if (clientIsBehind())
+  {
+    // Values stay dirty and are sent once the client has caught up
+    if (force)
+    {
+      for (auto& bound : bindings)
+      {
+        bound.hasValue = false;
+      }
+    }
+    return;
+  }
+  lastBindingRefresh = millis();
+
+  // Collect every changed value of the active page into a single frame
+  const size_t capacity = JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(bindings.size()) + bindings.size() * (JSON_OBJECT_SIZE(2) + MAX_NAME_LEN + MAX_VALUE_LEN) + 64;
+  DynamicJsonDocument doc(capacity);
+  if (doc.capacity() == 0)
+  {
+    debug("Failed to allocate JSON buffer for bound values");
+    return;
+  }
+  doc["type"] = "updates";
+  JsonArray updateArray = doc.createNestedArray("updates");
+  size_t changed = 0;
+
+  for (auto& bound : bindings)
+  {
+    if (strcmp(bound.pageName, activePage->name) != 0)
+    {
+      continue;
+    }
+    std::string value = bound.format();
+    if (!force && bound.hasValue && value == bound.lastSent)
+    {
+      continue;
+    }
+    bound.lastSent = value;
+    bound.hasValue = true;
+
+    JsonObject updateObj = updateArray.createNestedObject();
+    updateObj["target"] = bound.placeholder;
+    updateObj["content"] = bound.lastSent.c_str();
+    changed++;
+  }
+
+  if (changed == 0)
+  {
+    return;
+  }
+
+  std::string output;
+  serializeJson(doc, output);
+  if (!output.empty())
+  {
+    queueFrame(LANE_CONTROL, output);
+  }
+
+} // handleBindings()
+
+void SPAmanager::handleProviders()
+{
+  if (providers.empty())
+  {
+    return;
+  }
+
+  uint32_t now = millis();
+  for (auto& bound : providers)
+  {
+    // Providers only run while their page is on screen
+    bool isActive = hasConnectedClient && activePage && strcmp(activePage->name, bound.pageName) == 0;
+    if (!isActive)
+    {
+      bound.wasActive = false;
+      continue;
+    }
+    // Evaluate at once when the page comes into view, then at the bound rate
+    if (bound.wasActive && (now - bound.lastRun) < bound.intervalMs)
+    {
+      continue;
+    }
+    // A freshly streamed page does not have the value yet, send it even if it did not change
+    bool pageIsNew = !bound.wasActive;
+    bound.wasActive = true;
+    bound.lastRun = now;
+
+    std::string value = bound.provider();
+    if (bound.hasValue && value == bound.lastValue && !pageIsNew)
+    {
+      continue;
+    }
+    bound.lastValue = value;
+    bound.hasValue = true;
+
+    // Like a bound variable: the value is kept in RAM and goes to the client,
+    // neither the page file nor the value store is written at the provider rate
+    const size_t capacity = JSON_OBJECT_SIZE(3) + MAX_NAME_LEN + value.length() + 32;
+    DynamicJsonDocument doc(capacity);
+    doc["type"] = "update";
+    doc["target"] = bound.placeholder;
+    doc["content"] = value.c_str();
+    std::string output;
+    serializeJson(doc, output);
+    if (!output.empty())
+    {
+      queueFrame(LANE_CONTROL, output, bound.placeholder);
+    }
+  }
+
+} // handleProviders()
+
 void SPAmanager::setHeaderTitle(const char* title)
 {
   debug(("setHeaderTitle() called with title: " + std::string(title)).c_str());
@@ -1979,7 +3937,7 @@ void SPAmanager::setHeaderTitle(const char* title)
     
     if (!output.empty())
     {
-      ws.broadcastTXT(output.c_str(), output.length());
+      queueFrame(LANE_CONTROL, output, "title");
     }
   }
 }
@@ -2054,7 +4012,7 @@ std::string SPAmanager::generateHTML()
     }
     htmlFilePath += "/SPAmanager.html";
     
-    if (!filesystemAvailable || !LittleFS.exists(htmlFilePath.c_str())) {
+    if (!filesystemAvailable || !fileExists(htmlFilePath)) {
         debug("Using minimal HTML fallback");
         return MINIMAL_HTML;
     }
@@ -2100,10 +4058,10 @@ std::string SPAmanager::generateMenuHTML()
         }
         else
         {
-          menuHTML += "<span data-menu=\"" + std::string(menu.name) + "\" data-item=\"" + std::string(item.name) + "\"";
+          menuHTML += "<span data-menu=\"" + std::string(menu.name) + "\" data-item=\"" + std::string(item.name) + "\" data-id=\"" + std::to_string(item.id) + "\"";
           if (!item.disabled)
           {
-            menuHTML += " onclick=\"handleMenuClick('" + std::string(menu.name) + "', '" + std::string(item.name) + "')\"";
+            menuHTML += " onclick=\"handleMenuClick('" + std::string(menu.name) + "', '" + std::string(item.name) + "', " + std::to_string(item.id) + ")\"";
           }
           menuHTML += ">" + std::string(item.name) + "</span>";
         }
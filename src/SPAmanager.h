@@ -11,17 +11,47 @@
 #include <stdlib.h>
 #include <set>
 #include <map>
+#include <deque>
+#include <algorithm>
+#include "SPAvalueStore.h"
+#include "SPAstorage.h"
+#include "SPAassetCache.h"
+
+//-- A page prepared by compile_pages.py: minified html in flash, plus the offsets
+//-- of every element with an id, so the page never has to be scanned for them
+struct SPAcompiledPage 
+{
+  struct Element 
+  {
+    const char* id;
+    uint32_t tagStart;  // Offset of the '<' that opens the element
+    uint32_t tagEnd;    // Offset of the '>' that closes the opening tag
+    uint32_t textEnd;   // Offset of the next '<'
+  };
+  const char* name;
+  const char* html;
+  size_t size;
+  const Element* elements;
+  size_t elementCount;
+  const uint8_t* gzip;  // The html gzipped, nullptr if compile_pages.py did not compress it
+  size_t gzipSize;
+};
 
 class SPAmanager 
 {
   private:
     static const size_t MAX_NAME_LEN = 32;
     static const size_t MAX_URL_LEN = 64;
-    static const size_t MAX_CONTENT_LEN = 4096;
+    static const size_t MAX_TAG_LEN = 512;
     static const size_t MAX_ERROR_PAGE_LEN = 512;
     static const size_t MAX_MESSAGE_LEN = 80;
     static const size_t MAX_VALUE_LEN = 32;
     static const size_t MAX_PATH_LEN = 64;
+    static const size_t CLIENT_SEND_BUDGET = 8192;     // Unacknowledged bytes before a client counts as behind
+    static const uint32_t SLOW_CLIENT_TIMEOUT = 5000;  // ms a client may stay behind before it is dropped
+    static const size_t MAX_QUEUED_FRAMES = 32;
+    static const size_t ASSET_CACHE_BUDGET = 16 * 1024;         // RAM for hot files without PSRAM
+    static const size_t ASSET_CACHE_BUDGET_PSRAM = 256 * 1024;  // .. and with PSRAM
 
   public:
     WebServer server;
@@ -33,6 +63,8 @@ class SPAmanager
 
     //-- Page-related methods
     void addPage(const char* pageName, const char* html);
+    void addStaticPage(const char* pageName, const char* html);
+    void addCompiledPage(const SPAcompiledPage& compiled);
     void activatePage(const char* pageName);
     std::string getActivePageName() const;
     void setPageTitle(const char* pageName, const char* title);
@@ -43,8 +75,13 @@ class SPAmanager
     void addMenuItem(const char* pageName, const char* menuName, const char* itemName, const char* url);
     void addMenuItem(const char* pageName, const char* menuName, const char* itemName, std::function<void(const char*)> callback, const char* param);
     void addMenuItemPopup(const char* pageName, const char* menuName, const char* menuItem, const char* popupMenu, std::function<void(const std::map<std::string, std::string>&)> callback = nullptr);
+    void addMenuItemPopupFile(const char* pageName, const char* menuName, const char* menuItem, const char* popupFile, std::function<void(const std::map<std::string, std::string>&)> callback = nullptr);
     void enableMenuItem(const char* pageName, const char* menuName, const char* itemName);
     void disableMenuItem(const char* pageName, const char* menuName, const char* itemName);
+    //-- Popup templates, sent to a client once and opened by id after that
+    void addPopupTemplate(const char* popupId, const char* html, std::function<void(const std::map<std::string, std::string>&)> callback = nullptr);
+    void addPopupTemplateFile(const char* popupId, const char* filePath, std::function<void(const std::map<std::string, std::string>&)> callback = nullptr);
+    void openPopup(const char* popupId, const std::map<std::string, std::string>& values = {});
     bool pageExists(const char* pageName) const;
 
     //-- UI/Interaction methods
@@ -78,23 +115,92 @@ class SPAmanager
     void enableID(const char* pageName, const char* id);
     void disableID(const char* pageName, const char* id);
     void pageIsLoaded(std::function<void()> callback);
+    void onPageEnter(const char* pageName, std::function<void()> callback);
+    void onPageLeave(const char* pageName, std::function<void()> callback);
+
+    //-- Data binding methods
+    void bindProvider(const char* pageName, const char* placeholder, uint32_t intervalMs, std::function<std::string()> provider);
+    template <typename T>
+    void bind(const char* pageName, const char* placeholder, const T* variable, uint8_t decimals = 0);
+    void setBindingRefreshRate(uint32_t intervalMs);
+    enum ClientLogLevel : uint8_t 
+    {
+      CLIENT_LOG_ERRORS = 0,  // Only errors in the browser console
+      CLIENT_LOG_INFO,        // Errors and a few lines per page load
+      CLIENT_LOG_DEBUG        // Every frame that arrives
+    };
+    void setClientOptions(ClientLogLevel logLevel, bool useWorker = false);
+
+    //-- Outbound traffic
+    enum OutboundLane : uint8_t 
+    {
+      LANE_CONTROL = 0,  // Messages, title, popups, updates and JS calls
+      LANE_BULK,         // Page content chunks
+      LANE_COUNT
+    };
+    struct LaneStats 
+    {
+      size_t   queueDepth = 0;     // Frames waiting to be sent
+      size_t   maxQueueDepth = 0;
+      uint32_t framesSent = 0;
+      uint32_t lastLatencyMs = 0;  // Time the last sent frame spent in the lane
+      uint32_t maxLatencyMs = 0;
+    };
+    LaneStats getLaneStats(OutboundLane lane) const;
+    void resetLaneStats();
+    struct FlowStats 
+    {
+      size_t   outstandingBytes = 0;  // Sent to the client but not yet acknowledged
+      uint32_t framesMerged = 0;      // Queued updates replaced by a newer one for the same target
+      uint32_t framesDropped = 0;     // Frames discarded (superseded page chunks, queue overflow)
+      uint32_t clientsDropped = 0;    // Clients disconnected for staying over budget
+    };
+    FlowStats getFlowStats() const;
+
+    //-- Value store
+    bool useValueStore(SPAflashRegion& region);
+#ifdef ESP32
+    bool useValueStore(const char* partitionLabel = "spavalues");
+#endif
+    SPAvalueStore::Stats getValueStoreStats() const;
+    void refreshFileCache();
+    void setAssetCacheBudget(size_t budgetBytes, size_t maxFileSize = 0);
+    void enableServiceWorker(bool enable);
+    void enableFirstPageRendering(bool enable);
+    SPAassetCache::Stats getAssetCacheStats() const;
+    struct BootTimings 
+    {
+      uint32_t beginAtMs = 0;         // millis() when begin() was called
+      uint32_t manifestUs = 0;        // Loading the asset manifest
+      uint32_t checkUs = 0;           // Checking the system files
+      uint32_t routesUs = 0;          // Registering the web server routes
+      uint32_t serverStartUs = 0;     // server.begin()
+      uint32_t readyAtMs = 0;         // millis() when begin() returned
+      uint32_t firstRequestAtMs = 0;  // millis() when the first page request was served
+      uint32_t firstClientAtMs = 0;   // millis() when the first WebSocket client connected
+    };
+    BootTimings getBootTimings() const;
+    void setStorage(SPAstorage& pageStorage);
+    void loop();
     
     // Resource methods
     std::string getSystemFilePath() const;
     void includeCssFile(const std::string &cssFile);
-    void includeJsFile(const std::string &scriptFile);
+    void includeJsFile(const std::string &scriptFile, const std::vector<std::string>& dependsOn = {});
 
     static const char* MINIMAL_FSMANAGER_PAGE;
     static const char* MINIMAL_HTML; 
 
   private:
     static const char* PAGES_DIRECTORY;
+    static const char* PAGE_DIGESTS_FILE;
     Stream* debugOut;
     uint8_t currentClient;  //-- Store current connected client number
     bool hasConnectedClient;  //-- Track if we have a connected client
     std::string rootSystemPath;
     std::string firstPageName;  //-- Store the name of the first page added
     std::string activePageName; //-- Store the name of the active page
+    std::string enteredPageName; //-- Page whose onEnter fired last (empty if none is in view)
     std::function<void()> pageLoadedCallback;
     std::function<void(uint8_t, WStype_t, uint8_t*, size_t)> localEventsCallback;
 
@@ -111,8 +217,8 @@ class SPAmanager
         char name[MAX_NAME_LEN];
         char url[MAX_URL_LEN];
         std::function<void()> callback;
-        std::function<void(const std::map<std::string, std::string>&)> popupCallback; // Modified to accept input values
         bool disabled = false;
+        uint16_t id = 0;  // Index in menuItemTable, sent to the client with the menus
         
         void setName(const char* n) {
             strncpy(name, n, MAX_NAME_LEN-1);
@@ -150,6 +256,14 @@ class SPAmanager
       }
     };
 
+    struct IndexedElement 
+    {
+      const char* id;
+      size_t tagStart;
+      size_t tagEnd;
+      size_t textEnd;
+    };
+
     struct Page 
     {
       char name[MAX_NAME_LEN];
@@ -157,6 +271,14 @@ class SPAmanager
       char filePath[MAX_PATH_LEN];  // Store file path instead of content
       bool isVisible;
       bool isFileStorage;  // Flag to indicate if content is stored in a file
+      const char* staticContent = nullptr;  // Content served straight from the caller's (flash) string
+      size_t staticSize = 0;                // Length of staticContent, 0 if it has to be measured
+      const uint8_t* staticGzip = nullptr;  // staticContent gzipped, for clients that can decompress it
+      size_t staticGzipSize = 0;
+      std::vector<IndexedElement> elementIndex;  // Element offsets of a compiled page, kept up to date by patchElement()
+      mutable uint32_t contentDigest = 0;   // Digest of the current content, 0 until it is needed
+      std::function<void()> onEnter;  // Called when the page comes into view
+      std::function<void()> onLeave;  // Called when the page goes out of view
       
       void setName(const char* n) {
           strncpy(name, n, MAX_NAME_LEN-1);
@@ -175,13 +297,196 @@ class SPAmanager
           filePath[MAX_PATH_LEN-1] = '\0';
           isFileStorage = true;
       }
+      
+      bool hasContent() const {
+          return isFileStorage || staticContent;
+      }
+      
+      size_t staticLength() const {
+          return staticSize ? staticSize : strlen(staticContent);
+      }
+      
+      void clearStaticContent() {
+          staticContent = nullptr;
+          staticSize = 0;
+          staticGzip = nullptr;
+          staticGzipSize = 0;
+      }
+    };
+
+    struct ValueProvider 
+    {
+      char pageName[MAX_NAME_LEN];
+      char placeholder[MAX_NAME_LEN];
+      uint32_t intervalMs;
+      uint32_t lastRun = 0;
+      bool wasActive = false;  // Page was visible with a client on the previous pass
+      std::function<std::string()> provider;
+      std::string lastValue;   // Last value pushed, for change detection
+      bool hasValue = false;
+      
+      void setPageName(const char* n) {
+          strncpy(pageName, n, MAX_NAME_LEN-1);
+          pageName[MAX_NAME_LEN-1] = '\0';
+      }
+      
+      void setPlaceholder(const char* p) {
+          strncpy(placeholder, p, MAX_NAME_LEN-1);
+          placeholder[MAX_NAME_LEN-1] = '\0';
+      }
     };
 
     std::vector<Menu> menus;
     std::vector<Page> pages;
+    std::vector<ValueProvider> providers;
+
+    struct VariableBinding 
+    {
+      char pageName[MAX_NAME_LEN];
+      char placeholder[MAX_NAME_LEN];
+      std::function<std::string()> format;  // Formats the bound variable
+      std::string lastSent;                 // Last value pushed, for dirty-checking
+      bool hasValue = false;
+      
+      void setPageName(const char* n) {
+          strncpy(pageName, n, MAX_NAME_LEN-1);
+          pageName[MAX_NAME_LEN-1] = '\0';
+      }
+      
+      void setPlaceholder(const char* p) {
+          strncpy(placeholder, p, MAX_NAME_LEN-1);
+          placeholder[MAX_NAME_LEN-1] = '\0';
+      }
+    };
+    std::vector<VariableBinding> bindings;
+    uint32_t bindingRefreshMs = 250;
+    uint32_t lastBindingRefresh = 0;
+    ClientLogLevel clientLogLevel = CLIENT_LOG_DEBUG;
+    bool clientUsesWorker = false;
+
+    struct OutboundFrame 
+    {
+      std::string payload;
+      uint32_t queuedAt;
+      std::string target;  // Frames for the same target supersede each other (empty: never)
+    };
+    //-- Flow control: the client acknowledges the number of frames it received
+    struct ClientFlow 
+    {
+      std::deque<uint32_t> inFlight;  // Sizes of frames not yet acknowledged
+      size_t outstandingBytes = 0;
+      uint32_t framesSent = 0;
+      uint32_t framesAcked = 0;
+      bool ackSeen = false;           // Only clients that send acks are throttled
+      bool acceptsGzip = false;       // Asked for gzipped pages in the WebSocket url
+      std::map<std::string, uint32_t> pageDigests;  // Pages the client keeps, by content digest
+      std::map<std::string, std::string> popupDigests;  // Popup templates the client keeps, by content digest
+      uint32_t behindSince = 0;
+      bool disconnectPending = false;  // Queue overflowed, dropped from loop() by checkSlowClient()
+    };
+    //-- Page content is read from file one chunk at a time, only when the bulk lane gets its turn
+    struct PageStream 
+    {
+      SPAassetCache::Entry cached;   // Keeps a cached page alive while it is streamed
+      const char* memory = nullptr;  // Set when streaming a static page
+      bool gzip = false;             // Sent as binary frames after a 'pageGzip' header
+      bool headerSent = false;
+      size_t offset = 0;
+      std::string pageName;
+      std::string filePath;
+      size_t fileSize = 0;
+      int chunkIndex = 0;
+      int totalChunks = 0;
+      uint32_t queuedAt = 0;
+      uint32_t digest = 0;
+      bool active = false;
+    };
+    std::deque<OutboundFrame> outboundQueue[LANE_COUNT];
+    LaneStats laneStats[LANE_COUNT];
+    //-- Sequential reader over a page file or a static page
+    struct PageSource 
+    {
+      SPAstorage* storage = nullptr;
+      std::string path;
+      const char* memory = nullptr;
+      size_t size = 0;
+      size_t offset = 0;
+
+      size_t read(char* buffer, size_t length) {
+          if (memory) {
+              length = std::min(length, size - offset);
+              memcpy(buffer, memory + offset, length);
+          } else {
+              length = storage->read(path, offset, buffer, length);
+          }
+          offset += length;
+          return length;
+      }
+    };
+
+    //-- Where an element sits in a page, found by locateElement()
+    struct ElementLocation 
+    {
+      size_t tagStart = 0;  // Offset of the '<' that opens the element
+      size_t tagEnd = 0;    // Offset of the '>' that closes the opening tag
+      std::string tag;      // The opening tag itself
+      std::string text;     // Text up to the next '<' (only when asked for)
+    };
+
+    //-- Page storage, LittleFS unless setStorage() was called
+    SPAfsStorage defaultStorage{LittleFS};
+    SPAstorage* storage = &defaultStorage;
+
+    //-- Cached filesystem metadata for the pages directory and the system path
+    std::map<std::string, SPAstorage::Stat> fileInfoCache;
+
+    //-- System files as listed by the assets.idx manifest from the filesystem build
+    struct AssetInfo 
+    {
+      size_t size = 0;
+      uint32_t digest = 0;
+    };
+    std::map<std::string, AssetInfo> assetManifest;
+    std::map<std::string, uint32_t> assetDigests;  // Digests of files that are not in the manifest
+    BootTimings bootTimings;
+    std::set<std::string> cachedDirectories;  // Directories with all their entries in fileInfoCache
+
+    PageStream pageStream;
+    SPAvalueStore valueStore;
+    SPAassetCache assetCache;
+#ifdef ESP32
+    SPApartitionFlash valuePartition;
+#endif
+    std::map<uint8_t, ClientFlow> clientFlows;
+    FlowStats flowStats;
     Page* activePage;
     //-- Track which scripts have been served to avoid duplicates
     std::set<std::string> servedFiles;  
+    std::vector<std::string> servedOrder;  // servedFiles in the order they were included
+    std::map<std::string, std::vector<std::string>> assetDependencies;  // Included scripts and the scripts they need first
+    std::map<std::string, std::string> bundleVersions;  // Digest of /spa-bundle<extension>, built when first needed
+    bool serviceWorkerEnabled = false;
+    struct PopupTemplate 
+    {
+      const char* html = nullptr;  // In flash, or a string that lives as long as the SPAmanager
+      std::string filePath;        // Or a file on LittleFS, read when a client does not have it yet
+      std::string digest;          // Of the content, computed when it is first sent
+      std::function<void(const std::map<std::string, std::string>&)> callback;  // Gets the input values of a processAction()
+      uint16_t id = 0;             // Index in popupTable, sent to the client with the popup
+    };
+    std::map<std::string, PopupTemplate> popupTemplates;
+    std::vector<PopupTemplate*> popupTable;  // By id, entries of a std::map never move
+    //-- Where the menu item with an id lives, so a click is found without comparing names
+    struct MenuItemRef 
+    {
+      uint16_t menu;
+      uint16_t item;
+    };
+    std::vector<MenuItemRef> menuItemTable;
+    bool firstPageRendering = false;     // "/" sends the shell with the active page already in it
+    //-- Digest of the html each page file was last written from (0 = modified since)
+    std::map<std::string, uint32_t> pageDigests;
+    bool pageDigestsLoaded = false;
     
     //-- Server setup and handling
     void setupWebServer();
@@ -195,12 +500,78 @@ class SPAmanager
     //-- State management
     void broadcastState();
     void updateClients();
+    void handleProviders();
+    void updatePageLifecycle();
+    void handleBindings(bool force);
+    void addBinding(const char* pageName, const char* placeholder, std::function<std::string()> format);
     
     //-- File operations
     bool ensurePageDirectory();
-    std::string getPageContent(const Page& page);
+    bool openPageSource(const Page& page, PageSource& source);
+    bool readIndexedElement(const Page& page, const IndexedElement& indexed, ElementLocation& element, bool withText);
+    void reindexElements(Page& page, const ElementLocation& element, size_t tagLength, const char* text);
+    bool locateElement(const Page& page, const char* id, ElementLocation& element, bool withText);
+    bool patchElement(Page& page, const ElementLocation& element, const std::string& tag, const char* text);
+    bool updatePlaceholder(Page& page, const char* placeholder, const std::string& value);
+    static std::string valueKey(const char* pageName, const char* placeholder);
+    void sendStoredValues();
+    void sendClientOptions();
+    static std::string menuPopupId(const char* menuName, const char* itemName);
+    void addMenuItemPopupTemplate(const char* pageName, const char* menuName, const char* menuItem, const PopupTemplate& popup);
+    const std::string& popupDigest(PopupTemplate& popup);
+    void registerPopupTemplate(const std::string& popupId, const PopupTemplate& popup);
+    void addItemToMenu(Menu& menu, MenuItem& item);
+    void setElementDisplay(const char* pageName, const char* id, const char* display);
+    static size_t findTagAttribute(const std::string& tag, const char* name, char& quote);
+    static bool getTagAttribute(const std::string& tag, const char* name, std::string& value);
+    static void setTagAttribute(std::string& tag, const char* name, const std::string& value);
     bool writePageToFile(const char* pageName, const char* html);
+    bool writeFileAtomic(const char* filePath, const char* data, size_t length);
+    bool replaceFile(const std::string& tempPath, const char* filePath, size_t size);
+    SPAstorage::Stat getFileInfo(const std::string& path);
+    bool fileExists(const std::string& path);
+    bool isCachedPath(const std::string& path) const;
+    void cacheDirectory(const std::string& dirPath);
+    void fileWritten(const std::string& path, size_t size);
+    static std::string normalizePath(const std::string& path);
+    SPAstorage* storageFor(const std::string& path);
+    void serveAsset(const std::string& uri, const std::string& filePath);
+    void sendAsset(const std::string& filePath);
+    SPAassetCache::Entry cachedFile(SPAstorage& from, const std::string& filePath, size_t size);
+    static const char* contentTypeFor(const std::string& path);
+    std::string assetVersion(const std::string& filePath);
+    static std::string assetName(const std::string& filePath);
+    static std::string digestHex(uint32_t digest);
+    uint32_t pageDigest(const Page& page);
+    void pageStreamDone();
+    void sendAssetManifest();
+    void sendShellManifest();
+    bool sendRenderedShell();
+    static size_t closingDivTag(const std::string& html, size_t from);
+    std::string initialValuesScript();
+    std::vector<std::string> bundleFiles(const char* extension);
+    std::string bundleVersion(const char* extension);
+    void sendBundle(const char* extension);
+    static std::string readWholeFile(SPAstorage& from, const std::string& path);
+    bool loadAssetManifest(const std::string& sysPath);
+    void loadPageDigests();
+    bool savePageDigests();
+    static uint32_t computeDigest(const char* data, size_t length, uint32_t digest = 2166136261UL);
     void streamPageContent(const Page& page);
+    void pageContentChanged(const char* pageName);
+    void registerPage(const Page& page);
+
+    //-- Outbound lanes
+    void queueFrame(OutboundLane lane, const std::string& payload, const char* target = nullptr);
+    bool clientIsBehind();
+    void handleClientAck(uint8_t num, uint32_t framesReceived);
+    void checkSlowClient();
+    void disconnectSlowClient();
+    void clearOutbound();
+    void sendFrame(OutboundLane lane, const std::string& payload, uint32_t queuedAt, bool binary = false);
+    void processOutbound();
+    bool sendNextPageChunk();
+    void queueErrorPage();
 
     //-- Utility methods
     void debug(const char* message);
@@ -208,6 +579,7 @@ class SPAmanager
     void handleJsFunctionResult(const char* functionName, bool success);
     // Helper methods for validation
     bool menuExists(const char* pageName, const char* menuName) const;
+    Page* findPage(const char* pageName);
 #ifdef SPAMANAGER_DEBUG
     bool doDebug = true;
 #else
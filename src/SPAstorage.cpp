@@ -0,0 +1,367 @@
+//----- SPAstorage.cpp -----
+#include "SPAstorage.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <algorithm>
+
+static std::string parentOf(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    return (slash == 0 || slash == std::string::npos) ? "/" : path.substr(0, slash);
+}
+
+
+#ifdef ESP32
+// close the handles that refer to [path], so it can be renamed or removed
+void SPAfsStorage::release(const std::string& path)
+{
+    if (readPath == path) {
+        readFile.close();
+        readPath.clear();
+    }
+    if (writePath == path) {
+        writeFile.close();
+        writePath.clear();
+    }
+
+} // release()
+
+bool SPAfsStorage::stat(const std::string& path, Stat& info)
+{
+    info = Stat();
+    if (writePath == path) {
+        writeFile.flush();
+    }
+    if (!fileSystem.exists(path.c_str())) {
+        return false;
+    }
+    fs::File file = fileSystem.open(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    info.exists = true;
+    info.isDirectory = file.isDirectory();
+    info.size = info.isDirectory ? 0 : file.size();
+    info.lastWrite = file.getLastWrite();
+    file.close();
+    return true;
+
+} // stat()
+
+size_t SPAfsStorage::read(const std::string& path, size_t offset, void* buffer, size_t length)
+{
+    if (writePath == path) {
+        writeFile.close();
+        writePath.clear();
+    }
+    if (!readFile || readPath != path) {
+        readFile.close();
+        readPath.clear();
+        readFile = fileSystem.open(path.c_str(), "r");
+        if (!readFile) {
+            return 0;
+        }
+        readPath = path;
+    }
+    if (readFile.position() != offset && !readFile.seek(offset)) {
+        return 0;
+    }
+    return readFile.read((uint8_t*)buffer, length);
+
+} // read()
+
+bool SPAfsStorage::write(const std::string& path, const void* data, size_t length, bool append)
+{
+    if (!append || !writeFile || writePath != path) {
+        release(path);
+        writeFile.close();
+        writePath.clear();
+        writeFile = fileSystem.open(path.c_str(), append ? "a" : "w");
+        if (!writeFile) {
+            return false;
+        }
+        writePath = path;
+    }
+    return writeFile.write((const uint8_t*)data, length) == length;
+
+} // write()
+
+bool SPAfsStorage::replace(const std::string& tempPath, const std::string& path)
+{
+    release(tempPath);
+    release(path);
+    if (!fileSystem.rename(tempPath.c_str(), path.c_str())) {
+        // Not every filesystem renames over an existing file
+        fileSystem.remove(path.c_str());
+        if (!fileSystem.rename(tempPath.c_str(), path.c_str())) {
+            return false;
+        }
+    }
+    return true;
+
+} // replace()
+
+bool SPAfsStorage::remove(const std::string& path)
+{
+    release(path);
+    return fileSystem.remove(path.c_str());
+
+} // remove()
+
+bool SPAfsStorage::mkdir(const std::string& path)
+{
+    return fileSystem.mkdir(path.c_str());
+
+} // mkdir()
+
+bool SPAfsStorage::list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback)
+{
+    fs::File dir = fileSystem.open(dirPath.c_str(), "r");
+    if (!dir || !dir.isDirectory()) {
+        return false;
+    }
+    fs::File entry = dir.openNextFile();
+    while (entry) {
+        Stat info;
+        info.exists = true;
+        info.isDirectory = entry.isDirectory();
+        info.size = info.isDirectory ? 0 : entry.size();
+        info.lastWrite = entry.getLastWrite();
+        std::string entryPath = entry.path();
+        if (entryPath.empty() || entryPath[0] != '/') {
+            entryPath = "/" + entryPath;
+        }
+        callback(entryPath, info);
+        entry = dir.openNextFile();
+    }
+    dir.close();
+    return true;
+
+} // list()
+#endif
+
+
+bool SPAramStorage::stat(const std::string& path, Stat& info)
+{
+    info = Stat();
+    if (path == "/" || directories.count(path)) {
+        info.exists = true;
+        info.isDirectory = true;
+        return true;
+    }
+    auto it = files.find(path);
+    if (it == files.end()) {
+        return false;
+    }
+    info.exists = true;
+    info.size = it->second.size();
+    return true;
+
+} // stat()
+
+size_t SPAramStorage::read(const std::string& path, size_t offset, void* buffer, size_t length)
+{
+    auto it = files.find(path);
+    if (it == files.end() || offset >= it->second.size()) {
+        return 0;
+    }
+    length = std::min(length, it->second.size() - offset);
+    memcpy(buffer, it->second.data() + offset, length);
+    return length;
+
+} // read()
+
+bool SPAramStorage::write(const std::string& path, const void* data, size_t length, bool append)
+{
+    std::string& content = files[path];
+    if (!append) {
+        content.clear();
+    }
+    content.append((const char*)data, length);
+    return true;
+
+} // write()
+
+bool SPAramStorage::replace(const std::string& tempPath, const std::string& path)
+{
+    auto it = files.find(tempPath);
+    if (it == files.end()) {
+        return false;
+    }
+    files[path].swap(it->second);
+    files.erase(tempPath);
+    return true;
+
+} // replace()
+
+bool SPAramStorage::remove(const std::string& path)
+{
+    return files.erase(path) > 0 || directories.erase(path) > 0;
+
+} // remove()
+
+bool SPAramStorage::mkdir(const std::string& path)
+{
+    directories.insert(path);
+    return true;
+
+} // mkdir()
+
+bool SPAramStorage::list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback)
+{
+    if (dirPath != "/" && !directories.count(dirPath)) {
+        return false;
+    }
+    for (const auto& dir : directories) {
+        if (parentOf(dir) == dirPath) {
+            Stat info;
+            info.exists = true;
+            info.isDirectory = true;
+            callback(dir, info);
+        }
+    }
+    for (const auto& file : files) {
+        if (parentOf(file.first) == dirPath) {
+            Stat info;
+            info.exists = true;
+            info.size = file.second.size();
+            callback(file.first, info);
+        }
+    }
+    return true;
+
+} // list()
+
+size_t SPAramStorage::usedBytes() const
+{
+    size_t used = 0;
+    for (const auto& file : files) {
+        used += file.first.size() + file.second.size();
+    }
+    return used;
+
+} // usedBytes()
+
+
+SPAposixStorage::~SPAposixStorage()
+{
+    release(readPath);
+    release(writePath);
+
+} // ~SPAposixStorage()
+
+void SPAposixStorage::release(const std::string& path)
+{
+    if (readFile && readPath == path) {
+        fclose(readFile);
+        readFile = nullptr;
+        readPath.clear();
+    }
+    if (writeFile && writePath == path) {
+        fclose(writeFile);
+        writeFile = nullptr;
+        writePath.clear();
+    }
+
+} // release()
+
+bool SPAposixStorage::stat(const std::string& path, Stat& info)
+{
+    info = Stat();
+    if (writeFile && writePath == path) {
+        fflush(writeFile);
+    }
+    struct stat st;
+    if (::stat(fullPath(path).c_str(), &st) != 0) {
+        return false;
+    }
+    info.exists = true;
+    info.isDirectory = S_ISDIR(st.st_mode);
+    info.size = info.isDirectory ? 0 : st.st_size;
+    info.lastWrite = st.st_mtime;
+    return true;
+
+} // stat()
+
+size_t SPAposixStorage::read(const std::string& path, size_t offset, void* buffer, size_t length)
+{
+    if (writeFile && writePath == path) {
+        release(path);
+    }
+    if (!readFile || readPath != path) {
+        release(readPath);
+        readFile = fopen(fullPath(path).c_str(), "rb");
+        if (!readFile) {
+            return 0;
+        }
+        readPath = path;
+    }
+    if ((size_t)ftell(readFile) != offset && fseek(readFile, offset, SEEK_SET) != 0) {
+        return 0;
+    }
+    return fread(buffer, 1, length, readFile);
+
+} // read()
+
+bool SPAposixStorage::write(const std::string& path, const void* data, size_t length, bool append)
+{
+    if (!append || !writeFile || writePath != path) {
+        release(path);
+        release(writePath);
+        writeFile = fopen(fullPath(path).c_str(), append ? "ab" : "wb");
+        if (!writeFile) {
+            return false;
+        }
+        writePath = path;
+    }
+    return fwrite(data, 1, length, writeFile) == length;
+
+} // write()
+
+bool SPAposixStorage::replace(const std::string& tempPath, const std::string& path)
+{
+    release(tempPath);
+    release(path);
+    if (::rename(fullPath(tempPath).c_str(), fullPath(path).c_str()) != 0) {
+        ::remove(fullPath(path).c_str());
+        return ::rename(fullPath(tempPath).c_str(), fullPath(path).c_str()) == 0;
+    }
+    return true;
+
+} // replace()
+
+bool SPAposixStorage::remove(const std::string& path)
+{
+    release(path);
+    return ::remove(fullPath(path).c_str()) == 0;
+
+} // remove()
+
+bool SPAposixStorage::mkdir(const std::string& path)
+{
+    return ::mkdir(fullPath(path).c_str(), 0755) == 0;
+
+} // mkdir()
+
+bool SPAposixStorage::list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback)
+{
+    DIR* dir = opendir(fullPath(dirPath).c_str());
+    if (!dir) {
+        return false;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        std::string entryPath = (dirPath == "/" ? "" : dirPath) + "/" + entry->d_name;
+        Stat info;
+        if (stat(entryPath, info)) {
+            callback(entryPath, info);
+        }
+    }
+    closedir(dir);
+    return true;
+
+} // list()
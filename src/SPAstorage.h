@@ -0,0 +1,111 @@
+#ifndef SPA_STORAGE_H
+#define SPA_STORAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <map>
+#include <set>
+#include <functional>
+
+#ifdef ESP32
+  #include <FS.h>
+#endif
+
+//-- Where the SPAmanager keeps its page files. All paths start with a '/'.
+class SPAstorage
+{
+  public:
+    struct Stat
+    {
+      bool exists = false;
+      bool isDirectory = false;
+      size_t size = 0;
+      time_t lastWrite = 0;
+    };
+
+    virtual ~SPAstorage() {}
+    virtual bool stat(const std::string& path, Stat& info) = 0;
+    //-- Read up to [length] bytes from [offset], returns the number of bytes read
+    virtual size_t read(const std::string& path, size_t offset, void* buffer, size_t length) = 0;
+    //-- Create (or truncate) a file, or append to it
+    virtual bool write(const std::string& path, const void* data, size_t length, bool append) = 0;
+    //-- Move a completely written file over [path] in one step
+    virtual bool replace(const std::string& tempPath, const std::string& path) = 0;
+    virtual bool remove(const std::string& path) = 0;
+    virtual bool mkdir(const std::string& path) = 0;
+    virtual bool list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback) = 0;
+};
+
+#ifdef ESP32
+//-- Any Arduino filesystem (LittleFS, SD, ..). Keeps the last read and written file open,
+//-- so reading a page in chunks opens it only once.
+class SPAfsStorage : public SPAstorage
+{
+  public:
+    SPAfsStorage(fs::FS& fileSystem) : fileSystem(fileSystem) {}
+    bool stat(const std::string& path, Stat& info) override;
+    size_t read(const std::string& path, size_t offset, void* buffer, size_t length) override;
+    bool write(const std::string& path, const void* data, size_t length, bool append) override;
+    bool replace(const std::string& tempPath, const std::string& path) override;
+    bool remove(const std::string& path) override;
+    bool mkdir(const std::string& path) override;
+    bool list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback) override;
+
+  private:
+    void release(const std::string& path);
+
+    fs::FS& fileSystem;
+    fs::File readFile;
+    std::string readPath;
+    fs::File writeFile;
+    std::string writePath;
+};
+#endif
+
+//-- Files in RAM (PSRAM when the heap uses it). Nothing survives a reset.
+class SPAramStorage : public SPAstorage
+{
+  public:
+    bool stat(const std::string& path, Stat& info) override;
+    size_t read(const std::string& path, size_t offset, void* buffer, size_t length) override;
+    bool write(const std::string& path, const void* data, size_t length, bool append) override;
+    bool replace(const std::string& tempPath, const std::string& path) override;
+    bool remove(const std::string& path) override;
+    bool mkdir(const std::string& path) override;
+    bool list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback) override;
+    size_t usedBytes() const;
+
+  private:
+    std::map<std::string, std::string> files;
+    std::set<std::string> directories;
+};
+
+//-- Files below [rootPath] through stdio, e.g. "/littlefs" on an ESP32 (VFS) or a directory on a PC
+class SPAposixStorage : public SPAstorage
+{
+  public:
+    SPAposixStorage(const char* rootPath) : rootPath(rootPath) {}
+    ~SPAposixStorage();
+    bool stat(const std::string& path, Stat& info) override;
+    size_t read(const std::string& path, size_t offset, void* buffer, size_t length) override;
+    bool write(const std::string& path, const void* data, size_t length, bool append) override;
+    bool replace(const std::string& tempPath, const std::string& path) override;
+    bool remove(const std::string& path) override;
+    bool mkdir(const std::string& path) override;
+    bool list(const std::string& dirPath, std::function<void(const std::string&, const Stat&)> callback) override;
+
+  private:
+    std::string fullPath(const std::string& path) const { return rootPath + path; }
+    void release(const std::string& path);
+
+    std::string rootPath;
+    FILE* readFile = nullptr;
+    std::string readPath;
+    FILE* writeFile = nullptr;
+    std::string writePath;
+};
+
+#endif // SPA_STORAGE_H
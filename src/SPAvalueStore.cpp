@@ -0,0 +1,442 @@
+//----- SPAvalueStore.cpp -----
+#include "SPAvalueStore.h"
+#include <string.h>
+
+//
+// Bank layout:   [magic:4][generation:4][reserved:4][crc:4] [record] [record] ... [0xFF ...]
+// Record layout: [marker:1][keyLen:1][valueLen:2][crc:4] [key] [value]
+//
+// A bank only becomes valid when its header is written, which is the last step of a
+// compaction, so a power loss during compaction leaves the previous bank in charge.
+// A record that was cut short by a power loss fails its CRC; replay stops there and
+// the log is compacted to get rid of it.
+//
+
+static void putLe16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void putLe32(uint8_t* p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint32_t getLe32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+#ifdef ESP32
+bool SPApartitionFlash::begin(const char* label)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)PARTITION_SUBTYPE, label);
+    return partition != nullptr;
+
+} // begin()
+
+size_t SPApartitionFlash::size() const
+{
+    return partition ? partition->size : 0;
+
+} // size()
+
+bool SPApartitionFlash::read(size_t offset, void* data, size_t length)
+{
+    return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+
+} // read()
+
+bool SPApartitionFlash::write(size_t offset, const void* data, size_t length)
+{
+    return partition && esp_partition_write(partition, offset, data, length) == ESP_OK;
+
+} // write()
+
+bool SPApartitionFlash::eraseSector(size_t offset)
+{
+    return partition && esp_partition_erase_range(partition, offset, sectorSize()) == ESP_OK;
+
+} // eraseSector()
+#endif
+
+
+SPAramFlash::SPAramFlash(size_t size, size_t sectorSize) : memory(size, 0xFF), sector(sectorSize)
+{
+}
+
+bool SPAramFlash::read(size_t offset, void* data, size_t length)
+{
+    if (offset + length > memory.size()) {
+        return false;
+    }
+    memcpy(data, memory.data() + offset, length);
+    stats.bytesRead += length;
+    return true;
+
+} // read()
+
+bool SPAramFlash::write(size_t offset, const void* data, size_t length)
+{
+    if (!powered || offset + length > memory.size()) {
+        return false;
+    }
+    bool powerLost = false;
+    if (failArmed && length > failBudget) {
+        length = failBudget;
+        powerLost = true;
+    }
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        memory[offset + i] &= bytes[i];  // NOR flash can only clear bits
+    }
+    stats.bytesWritten += length;
+    if (powerLost) {
+        powered = false;
+        failArmed = false;
+        return false;
+    }
+    if (failArmed) {
+        failBudget -= length;
+    }
+    return true;
+
+} // write()
+
+bool SPAramFlash::eraseSector(size_t offset)
+{
+    if (!powered || offset % sector != 0 || offset + sector > memory.size()) {
+        return false;
+    }
+    memset(memory.data() + offset, 0xFF, sector);
+    stats.sectorsErased++;
+    return true;
+
+} // eraseSector()
+
+void SPAramFlash::failAfterBytes(size_t bytes)
+{
+    failArmed = true;
+    failBudget = bytes;
+
+} // failAfterBytes()
+
+void SPAramFlash::powerCycle()
+{
+    powered = true;
+    failArmed = false;
+
+} // powerCycle()
+
+
+uint32_t SPAvalueStore::crc32(const uint8_t* data, size_t length, uint32_t crc)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+
+} // crc32()
+
+
+bool SPAvalueStore::begin(SPAflashRegion& region)
+{
+    flash = nullptr;
+    entries.clear();
+    stats = Stats();
+
+    // Two banks, each a whole number of sectors
+    size_t sector = region.sectorSize();
+    bankSize = (region.size() / 2) / sector * sector;
+    if (bankSize == 0 || bankSize <= BANK_HEADER_SIZE) {
+        return false;
+    }
+    flash = &region;
+    stats.logSize = bankSize;
+
+    uint32_t generation0 = 0;
+    uint32_t generation1 = 0;
+    bool valid0 = readBankHeader(0, generation0);
+    bool valid1 = readBankHeader(1, generation1);
+    if (!valid0 && !valid1) {
+        if (!format()) {
+            flash = nullptr;
+            return false;
+        }
+    } else {
+        activeBank = (valid0 && (!valid1 || generation0 > generation1)) ? 0 : 1;
+        generation = activeBank == 0 ? generation0 : generation1;
+    }
+
+    replay();
+    if (tailDamaged) {
+        compact();
+    }
+    stats.liveEntries = entries.size();
+    stats.logUsed = writeOffset;
+    return true;
+
+} // begin()
+
+
+bool SPAvalueStore::readBankHeader(uint8_t bank, uint32_t& bankGeneration)
+{
+    uint8_t header[BANK_HEADER_SIZE];
+    if (!flash->read(bankBase(bank), header, sizeof(header))) {
+        return false;
+    }
+    if (getLe32(header) != BANK_MAGIC || getLe32(header + 12) != crc32(header, 12)) {
+        return false;
+    }
+    bankGeneration = getLe32(header + 4);
+    return true;
+
+} // readBankHeader()
+
+
+bool SPAvalueStore::writeBankHeader(uint8_t bank, uint32_t bankGeneration)
+{
+    uint8_t header[BANK_HEADER_SIZE];
+    putLe32(header, BANK_MAGIC);
+    putLe32(header + 4, bankGeneration);
+    putLe32(header + 8, 0xFFFFFFFF);
+    putLe32(header + 12, crc32(header, 12));
+    if (!flash->write(bankBase(bank), header, sizeof(header))) {
+        return false;
+    }
+    stats.flashBytesWritten += sizeof(header);
+    return true;
+
+} // writeBankHeader()
+
+
+bool SPAvalueStore::eraseBank(uint8_t bank)
+{
+    size_t sector = flash->sectorSize();
+    for (size_t offset = 0; offset < bankSize; offset += sector) {
+        if (!flash->eraseSector(bankBase(bank) + offset)) {
+            return false;
+        }
+    }
+    return true;
+
+} // eraseBank()
+
+
+bool SPAvalueStore::format()
+{
+    if (!eraseBank(0) || !writeBankHeader(0, 1)) {
+        return false;
+    }
+    activeBank = 0;
+    generation = 1;
+    writeOffset = BANK_HEADER_SIZE;
+    return true;
+
+} // format()
+
+
+// rebuild the values from the log of the active bank
+void SPAvalueStore::replay()
+{
+    entries.clear();
+    tailDamaged = false;
+    size_t offset = BANK_HEADER_SIZE;
+    uint8_t header[RECORD_HEADER_SIZE];
+    std::vector<uint8_t> body;
+
+    while (offset + RECORD_HEADER_SIZE <= bankSize) {
+        if (!flash->read(bankBase(activeBank) + offset, header, sizeof(header))) {
+            tailDamaged = true;
+            break;
+        }
+        bool erased = true;
+        for (size_t i = 0; i < sizeof(header); i++) {
+            erased = erased && header[i] == 0xFF;
+        }
+        if (erased) {
+            break;  // End of the log
+        }
+
+        uint8_t keyLength = header[1];
+        uint16_t valueLength = header[2] | (header[3] << 8);
+        size_t bodyLength = keyLength + (valueLength == TOMBSTONE ? 0 : valueLength);
+        if (header[0] != RECORD_MARKER || keyLength == 0 || offset + RECORD_HEADER_SIZE + bodyLength > bankSize) {
+            tailDamaged = true;
+            break;
+        }
+        body.resize(bodyLength);
+        if (!flash->read(bankBase(activeBank) + offset + RECORD_HEADER_SIZE, body.data(), bodyLength)
+                || crc32(body.data(), bodyLength, crc32(header, 4)) != getLe32(header + 4)) {
+            tailDamaged = true;
+            break;
+        }
+
+        std::string key((const char*)body.data(), keyLength);
+        if (valueLength == TOMBSTONE) {
+            entries.erase(key);
+        } else {
+            entries[key] = std::string((const char*)body.data() + keyLength, valueLength);
+        }
+        offset += RECORD_HEADER_SIZE + bodyLength;
+        stats.replayedRecords++;
+    }
+    if (tailDamaged) {
+        stats.tornRecords++;
+    }
+    writeOffset = offset;
+
+} // replay()
+
+
+// append a record at [offset] of the active bank, a null value writes a tombstone
+bool SPAvalueStore::appendRecord(size_t& offset, const std::string& key, const std::string* value)
+{
+    uint16_t valueLength = value ? value->length() : TOMBSTONE;
+    size_t recordLength = RECORD_HEADER_SIZE + key.length() + (value ? value->length() : 0);
+    if (offset + recordLength > bankSize) {
+        return false;
+    }
+
+    std::vector<uint8_t> record(recordLength);
+    record[0] = RECORD_MARKER;
+    record[1] = key.length();
+    putLe16(&record[2], valueLength);
+    memcpy(&record[RECORD_HEADER_SIZE], key.data(), key.length());
+    if (value) {
+        memcpy(&record[RECORD_HEADER_SIZE + key.length()], value->data(), value->length());
+    }
+    putLe32(&record[4], crc32(&record[RECORD_HEADER_SIZE], recordLength - RECORD_HEADER_SIZE, crc32(record.data(), 4)));
+
+    if (!flash->write(bankBase(activeBank) + offset, record.data(), recordLength)) {
+        // Part of the record may be on flash, don't append behind it
+        tailDamaged = true;
+        return false;
+    }
+    offset += recordLength;
+    stats.flashBytesWritten += recordLength;
+    return true;
+
+} // appendRecord()
+
+
+bool SPAvalueStore::set(const std::string& key, const std::string& value)
+{
+    if (!flash || key.empty() || key.length() > 255 || value.length() >= TOMBSTONE) {
+        return false;
+    }
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second == value) {
+        return true;  // Unchanged, nothing to write
+    }
+    stats.payloadBytes += key.length() + value.length();
+
+    if (!tailDamaged && appendRecord(writeOffset, key, &value)) {
+        entries[key] = value;
+    } else {
+        // Bank is full (or its tail is damaged): compact with the new value included
+        bool existed = (it != entries.end());
+        std::string previous = existed ? it->second : std::string();
+        entries[key] = value;
+        if (!compact()) {
+            if (existed) {
+                entries[key] = previous;
+            } else {
+                entries.erase(key);
+            }
+            return false;
+        }
+    }
+    stats.liveEntries = entries.size();
+    stats.logUsed = writeOffset;
+    return true;
+
+} // set()
+
+
+bool SPAvalueStore::get(const std::string& key, std::string& value) const
+{
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+
+} // get()
+
+
+bool SPAvalueStore::remove(const std::string& key)
+{
+    if (!flash) {
+        return false;
+    }
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return true;
+    }
+    stats.payloadBytes += key.length();
+    std::string previous = it->second;
+    entries.erase(it);
+
+    if (tailDamaged || !appendRecord(writeOffset, key, nullptr)) {
+        if (!compact()) {
+            entries[key] = previous;
+            return false;
+        }
+    }
+    stats.liveEntries = entries.size();
+    stats.logUsed = writeOffset;
+    return true;
+
+} // remove()
+
+
+// copy the live values into the other bank and switch to it
+bool SPAvalueStore::compact()
+{
+    if (!flash) {
+        return false;
+    }
+    uint8_t previousBank = activeBank;
+    activeBank ^= 1;
+    size_t offset = BANK_HEADER_SIZE;
+    bool success = eraseBank(activeBank);
+    for (auto it = entries.begin(); success && it != entries.end(); ++it) {
+        success = appendRecord(offset, it->first, &it->second);
+    }
+    success = success && writeBankHeader(activeBank, generation + 1);
+    if (!success) {
+        // The previous bank is still valid
+        activeBank = previousBank;
+        return false;
+    }
+    generation++;
+    writeOffset = offset;
+    tailDamaged = false;
+    stats.compactions++;
+    stats.liveEntries = entries.size();
+    stats.logUsed = writeOffset;
+    return true;
+
+} // compact()
+
+
+void SPAvalueStore::forEach(const std::string& prefix, std::function<void(const std::string&, const std::string&)> callback) const
+{
+    for (auto it = entries.lower_bound(prefix); it != entries.end(); ++it) {
+        if (it->first.compare(0, prefix.length(), prefix) != 0) {
+            break;
+        }
+        callback(it->first, it->second);
+    }
+
+} // forEach()
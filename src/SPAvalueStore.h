@@ -0,0 +1,132 @@
+#ifndef SPA_VALUE_STORE_H
+#define SPA_VALUE_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+#ifdef ESP32
+  #include <esp_partition.h>
+#endif
+
+//-- A piece of NOR flash: writes can only clear bits, erasing sets a whole sector back to 0xFF
+class SPAflashRegion
+{
+  public:
+    virtual ~SPAflashRegion() {}
+    virtual size_t size() const = 0;
+    virtual size_t sectorSize() const = 0;
+    virtual bool read(size_t offset, void* data, size_t length) = 0;
+    virtual bool write(size_t offset, const void* data, size_t length) = 0;
+    virtual bool eraseSector(size_t offset) = 0;
+};
+
+#ifdef ESP32
+//-- A data partition, e.g. "spavalues, 0x40, 0x00, 0x3F0000, 0x10000" in the partition table
+class SPApartitionFlash : public SPAflashRegion
+{
+  public:
+    static const uint8_t PARTITION_SUBTYPE = 0x40;
+
+    bool begin(const char* label);
+    size_t size() const override;
+    size_t sectorSize() const override { return 4096; }
+    bool read(size_t offset, void* data, size_t length) override;
+    bool write(size_t offset, const void* data, size_t length) override;
+    bool eraseSector(size_t offset) override;
+
+  private:
+    const esp_partition_t* partition = nullptr;
+};
+#endif
+
+//-- RAM backed flash with NOR semantics, runs on the device and on a Linux host.
+//-- Counts what is written and erased and can simulate a power loss in the middle of a write.
+class SPAramFlash : public SPAflashRegion
+{
+  public:
+    struct Stats
+    {
+      uint32_t bytesWritten = 0;
+      uint32_t bytesRead = 0;
+      uint32_t sectorsErased = 0;
+    };
+
+    SPAramFlash(size_t size, size_t sectorSize = 4096);
+    size_t size() const override { return memory.size(); }
+    size_t sectorSize() const override { return sector; }
+    bool read(size_t offset, void* data, size_t length) override;
+    bool write(size_t offset, const void* data, size_t length) override;
+    bool eraseSector(size_t offset) override;
+
+    void failAfterBytes(size_t bytes);  // Power is lost after this many more bytes are written
+    void powerCycle();                  // Power is back, the flash keeps what was written
+    bool isPowered() const { return powered; }
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+  private:
+    std::vector<uint8_t> memory;
+    size_t sector;
+    bool powered = true;
+    bool failArmed = false;
+    size_t failBudget = 0;
+    Stats stats;
+};
+
+//-- Append-only key/value log in two banks. A value change appends one small CRC protected
+//-- record; when a bank is full the live values are compacted into the other bank.
+class SPAvalueStore
+{
+  public:
+    struct Stats
+    {
+      uint32_t liveEntries = 0;
+      uint32_t replayedRecords = 0;   // Records read by the last begin()
+      uint32_t tornRecords = 0;       // Damaged records found by the last begin()
+      uint32_t compactions = 0;
+      uint32_t payloadBytes = 0;      // Key and value bytes handed to set()/remove()
+      uint32_t flashBytesWritten = 0; // Bytes written to flash, including compaction
+      size_t   logUsed = 0;           // Bytes in use in the active bank
+      size_t   logSize = 0;           // Size of a bank
+    };
+
+    bool begin(SPAflashRegion& region);
+    bool isOpen() const { return flash != nullptr; }
+    bool set(const std::string& key, const std::string& value);
+    bool get(const std::string& key, std::string& value) const;
+    bool remove(const std::string& key);
+    bool compact();
+    void forEach(const std::string& prefix, std::function<void(const std::string&, const std::string&)> callback) const;
+    const Stats& getStats() const { return stats; }
+
+  private:
+    static const uint32_t BANK_MAGIC = 0x56415053;  // "SPAV"
+    static const uint8_t  RECORD_MARKER = 0xA5;
+    static const uint16_t TOMBSTONE = 0xFFFF;
+    static const size_t   BANK_HEADER_SIZE = 16;
+    static const size_t   RECORD_HEADER_SIZE = 8;
+
+    bool readBankHeader(uint8_t bank, uint32_t& generation);
+    bool writeBankHeader(uint8_t bank, uint32_t generation);
+    bool eraseBank(uint8_t bank);
+    bool format();
+    void replay();
+    bool appendRecord(size_t& offset, const std::string& key, const std::string* value);
+    size_t bankBase(uint8_t bank) const { return bank * bankSize; }
+    static uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+    SPAflashRegion* flash = nullptr;
+    size_t bankSize = 0;
+    uint8_t activeBank = 0;
+    uint32_t generation = 0;
+    size_t writeOffset = 0;
+    bool tailDamaged = false;
+    std::map<std::string, std::string> entries;
+    Stats stats;
+};
+
+#endif // SPA_VALUE_STORE_H
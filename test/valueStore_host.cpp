@@ -0,0 +1,224 @@
+//----- valueStore_host.cpp -----
+//-- Tests and benchmarks SPAvalueStore on a Linux host, on the SPAramFlash simulator.
+//--   make -C test
+//-- Exits with 1 when a check fails.
+
+#include "SPAvalueStore.h"
+#include <stdio.h>
+#include <chrono>
+#include <map>
+#include <string>
+
+#define FLASH_SIZE     (64 * 1024)
+#define VALUE_UPDATES  5000
+#define PAGE_SIZE      2048   // A page file that would be rewritten for every change
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static bool check(bool condition, const char* text, int line)
+{
+    checks++;
+    if (!condition)
+    {
+        failures++;
+        printf("  FAILED (line %d): %s\n", line, text);
+    }
+    return condition;
+
+} // check()
+
+static const char* keys[] = { "Main/clock", "Main/temperature", "Counter/counter", "Counter/counterState",
+                              "InputPage/input1", "InputPage/input2", "InputPage/input3" };
+static const size_t keyCount = sizeof(keys) / sizeof(keys[0]);
+
+static void fillStore(SPAvalueStore& store, uint32_t updates, uint32_t firstValue = 0)
+{
+    for (uint32_t i = 0; i < updates; i++)
+    {
+        store.set(keys[i % keyCount], std::to_string(firstValue + i));
+    }
+
+} // fillStore()
+
+static std::map<std::string, std::string> contents(const SPAvalueStore& store)
+{
+    std::map<std::string, std::string> values;
+    store.forEach("", [&values](const std::string& key, const std::string& value) { values[key] = value; });
+    return values;
+
+} // contents()
+
+
+static void testRoundTrip()
+{
+    printf("Round trip\n");
+    SPAramFlash flash(FLASH_SIZE);
+    SPAvalueStore store;
+    CHECK(store.begin(flash));
+
+    std::string value;
+    CHECK(!store.get("Main/clock", value));
+    CHECK(store.set("Main/clock", "12:00"));
+    CHECK(store.set("Main/temperature", "21.5"));
+    CHECK(store.set("Main/clock", "12:01"));
+    CHECK(store.set("Main/empty", ""));
+    CHECK(store.get("Main/clock", value) && value == "12:01");
+    CHECK(store.get("Main/empty", value) && value.empty());
+    CHECK(store.remove("Main/temperature"));
+    CHECK(!store.get("Main/temperature", value));
+
+    int counted = 0;
+    store.forEach("Main/", [&counted](const std::string&, const std::string&) { counted++; });
+    CHECK(counted == 2);
+
+    // Everything comes back after a reboot
+    SPAvalueStore rebooted;
+    CHECK(rebooted.begin(flash));
+    CHECK(contents(rebooted) == contents(store));
+    CHECK(rebooted.getStats().tornRecords == 0);
+
+} // testRoundTrip()
+
+
+static void testCompaction()
+{
+    printf("Compaction\n");
+    SPAramFlash flash(FLASH_SIZE);
+    SPAvalueStore store;
+    CHECK(store.begin(flash));
+    fillStore(store, VALUE_UPDATES);
+    CHECK(store.getStats().compactions > 0);
+    CHECK(store.getStats().liveEntries == keyCount);
+
+    // The last value of every key survives the compactions
+    std::map<std::string, std::string> expected;
+    for (uint32_t i = VALUE_UPDATES - keyCount; i < VALUE_UPDATES; i++)
+    {
+        expected[keys[i % keyCount]] = std::to_string(i);
+    }
+    CHECK(contents(store) == expected);
+
+    size_t usedBefore = store.getStats().logUsed;
+    uint32_t compactionsBefore = store.getStats().compactions;
+    CHECK(store.compact());
+    CHECK(store.getStats().compactions == compactionsBefore + 1);
+    CHECK(store.getStats().logUsed <= usedBefore);
+    CHECK(contents(store) == expected);
+
+    SPAvalueStore rebooted;
+    CHECK(rebooted.begin(flash));
+    CHECK(contents(rebooted) == expected);
+
+} // testCompaction()
+
+
+//-- Cut the power after a growing number of bytes, covering appends and compactions.
+//-- Every value set() reported as written must be there after the reboot; only the
+//-- interrupted set() may have either its old or its new value.
+static void testPowerLoss()
+{
+    printf("Power loss\n");
+    uint32_t runs = 0;
+    uint32_t recovered = 0;
+
+    for (size_t cut = 0; cut < FLASH_SIZE / 2; cut += 97)
+    {
+        SPAramFlash flash(FLASH_SIZE);
+        SPAvalueStore store;
+        store.begin(flash);
+        fillStore(store, 500);
+        std::map<std::string, std::string> committed = contents(store);
+
+        flash.failAfterBytes(cut);
+        std::string lastKey;
+        std::string lastValue;
+        for (uint32_t i = 500; flash.isPowered(); i++)
+        {
+            lastKey = keys[i % keyCount];
+            lastValue = std::to_string(i);
+            if (store.set(lastKey, lastValue))
+            {
+                committed[lastKey] = lastValue;
+            }
+        }
+        flash.powerCycle();
+
+        SPAvalueStore rebooted;
+        bool valid = rebooted.begin(flash);
+        for (const auto& entry : committed)
+        {
+            std::string value;
+            bool found = rebooted.get(entry.first, value);
+            valid = valid && found && (value == entry.second || (entry.first == lastKey && value == lastValue));
+        }
+        if (!valid)
+        {
+            printf("  lost a committed value with the power cut after %u bytes\n", (unsigned)cut);
+        }
+        CHECK(valid);
+        runs++;
+        recovered += valid ? 1 : 0;
+
+        // The store keeps working after the recovery
+        CHECK(rebooted.set("Main/clock", "after"));
+        std::string value;
+        CHECK(rebooted.get("Main/clock", value) && value == "after");
+    }
+    printf("  %u of %u runs recovered\n", recovered, runs);
+
+} // testPowerLoss()
+
+
+static void benchmark()
+{
+    printf("Benchmark\n");
+    SPAramFlash flash(FLASH_SIZE);
+    SPAvalueStore store;
+    store.begin(flash);
+    flash.resetStats();
+
+    auto start = std::chrono::steady_clock::now();
+    fillStore(store, VALUE_UPDATES);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    const SPAvalueStore::Stats& stats = store.getStats();
+    printf("  %u updates in %lld us\n", VALUE_UPDATES, (long long)elapsed.count());
+    printf("  payload      : %u bytes\n", stats.payloadBytes);
+    printf("  flash written: %u bytes (%.2fx)\n", flash.getStats().bytesWritten,
+              (float)flash.getStats().bytesWritten / stats.payloadBytes);
+    printf("  sectors erased: %u, compactions: %u\n", flash.getStats().sectorsErased, stats.compactions);
+    printf("  rewriting a %u byte page per update: %.2fx\n", PAGE_SIZE,
+              (float)PAGE_SIZE * VALUE_UPDATES / stats.payloadBytes);
+
+    // Stop just before the bank is full, so the replay reads the longest possible log
+    SPAramFlash fullFlash(FLASH_SIZE);
+    SPAvalueStore full;
+    full.begin(fullFlash);
+    while (full.getStats().logUsed + 64 < full.getStats().logSize)
+    {
+        fillStore(full, 1, full.getStats().logUsed);
+    }
+    SPAvalueStore replayed;
+    start = std::chrono::steady_clock::now();
+    replayed.begin(fullFlash);
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    printf("  replay of %u records (%u bytes): %lld us\n", replayed.getStats().replayedRecords,
+              (unsigned)replayed.getStats().logUsed, (long long)elapsed.count());
+
+} // benchmark()
+
+
+int main()
+{
+    testRoundTrip();
+    testCompaction();
+    testPowerLoss();
+    benchmark();
+
+    printf("%u checks, %u failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+
+} // main()